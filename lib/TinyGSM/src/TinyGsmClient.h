@@ -12,29 +12,36 @@
 #if defined(TINY_GSM_MODEM_SIM800)
   #define TINY_GSM_MODEM_HAS_GPRS
   #define TINY_GSM_MODEM_HAS_SSL
+  #define TINY_GSM_MODEM_HAS_READ_AHEAD
   #include <TinyGsmClientSIM800.h>
   typedef TinyGsmSim800 TinyGsm;
   typedef TinyGsmSim800::GsmClient TinyGsmClient;
   typedef TinyGsmSim800::GsmClientSecure TinyGsmClientSecure;
+  typedef TinyGsmSim800::GsmClientTransparent TinyGsmClientTransparent;
 
 #elif defined(TINY_GSM_MODEM_SIM808) || defined(TINY_GSM_MODEM_SIM868)
   #define TINY_GSM_MODEM_HAS_GPRS
   #define TINY_GSM_MODEM_HAS_SSL
   #define TINY_GSM_MODEM_HAS_GPS
+  #define TINY_GSM_MODEM_HAS_READ_AHEAD
   #include <TinyGsmClientSIM808.h>
   typedef TinyGsmSim808 TinyGsm;
   typedef TinyGsmSim808::GsmClient TinyGsmClient;
   typedef TinyGsmSim808::GsmClientSecure TinyGsmClientSecure;
+  typedef TinyGsmSim808::GsmClientTransparent TinyGsmClientTransparent;
 
 #elif defined(TINY_GSM_MODEM_SIM900)
   #define TINY_GSM_MODEM_HAS_GPRS
+  #define TINY_GSM_MODEM_HAS_READ_AHEAD
   #include <TinyGsmClientSIM800.h>
   typedef TinyGsmSim800 TinyGsm;
   typedef TinyGsmSim800::GsmClient TinyGsmClient;
+  typedef TinyGsmSim800::GsmClientTransparent TinyGsmClientTransparent;
 
 #elif defined(TINY_GSM_MODEM_SIM7000)
   #define TINY_GSM_MODEM_HAS_GPRS
   #define TINY_GSM_MODEM_HAS_GPS
+  #define TINY_GSM_MODEM_HAS_READ_AHEAD
   #include <TinyGsmClientSIM7000.h>
   typedef TinyGsmSim7000 TinyGsm;
   typedef TinyGsmSim7000::GsmClient TinyGsmClient;
@@ -43,6 +50,7 @@
 #elif defined(TINY_GSM_MODEM_SIM5320) || defined(TINY_GSM_MODEM_SIM5360) || \
       defined(TINY_GSM_MODEM_SIM5300) || defined(TINY_GSM_MODEM_SIM7100)
   #define TINY_GSM_MODEM_HAS_GPRS
+  #define TINY_GSM_MODEM_HAS_READ_AHEAD
   #include <TinyGsmClientSIM5360.h>
   typedef TinyGsmSim5360 TinyGsm;
   typedef TinyGsmSim5360::GsmClient TinyGsmClient;
@@ -50,9 +58,11 @@
 #elif defined(TINY_GSM_MODEM_SIM7600) || defined(TINY_GSM_MODEM_SIM7800) || \
     defined(TINY_GSM_MODEM_SIM7500)
   #define TINY_GSM_MODEM_HAS_GPRS
+  #define TINY_GSM_MODEM_HAS_READ_AHEAD
   #include <TinyGsmClientSIM7600.h>
   typedef TinyGsmSim7600 TinyGsm;
   typedef TinyGsmSim7600::GsmClient TinyGsmClient;
+  typedef TinyGsmSim7600::GsmClientTransparent TinyGsmClientTransparent;
 
 #elif defined(TINY_GSM_MODEM_UBLOX)
   #define TINY_GSM_MODEM_HAS_GPRS
@@ -81,6 +91,7 @@
   #include <TinyGsmClientBG96.h>
   typedef TinyGsmBG96 TinyGsm;
   typedef TinyGsmBG96::GsmClient TinyGsmClient;
+  typedef TinyGsmBG96::GsmClientTransparent TinyGsmClientTransparent;
 
 #elif defined(TINY_GSM_MODEM_A6) || defined(TINY_GSM_MODEM_A7)
   #define TINY_GSM_MODEM_HAS_GPRS
@@ -85,6 +85,7 @@ TINY_GSM_CLIENT_CONNECT_OVERLOADS()
 
   virtual void stop(uint32_t maxWaitMs) {
     TINY_GSM_YIELD();
+    TINY_GSM_CLIENT_TX_FINISH()
     at->sendAT(GF("+CIPCLOSE="), mux);
     sock_connected = false;
     at->waitResponse(maxWaitMs);
@@ -348,7 +349,7 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     if (waitResponse(GF(GSM_NL "+CGATT:")) != 1) {
       return false;
     }
-    int res = stream.readStringUntil('\n').toInt();
+    int res = streamReadInt('\n');
     waitResponse();
     return (res == 1);
   }
@@ -474,7 +475,7 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     stream.readStringUntil('"');
     String hex = stream.readStringUntil('"');
     stream.readStringUntil(',');
-    int dcs = stream.readStringUntil('\n').toInt();
+    int dcs = streamReadInt('\n');
 
     if (dcs == 15) {
       return TinyGsmDecodeHex7bit(hex);
@@ -518,7 +519,7 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     }
     streamSkipUntil(','); // Skip battery charge status
     // Read battery charge level
-    int res = stream.readStringUntil('\n').toInt();
+    int res = streamReadInt('\n');
     // Wait for final OK
     waitResponse();
     return res;
@@ -530,7 +531,7 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
       return false;
     }
     // Read battery charge status
-    int res = stream.readStringUntil(',').toInt();
+    int res = streamReadInt(',');
     // Wait for final OK
     waitResponse();
     return res;
@@ -541,8 +542,8 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     if (waitResponse(GF(GSM_NL "+CBC:")) != 1) {
       return false;
     }
-    chargeState = stream.readStringUntil(',').toInt();
-    percent = stream.readStringUntil('\n').toInt();
+    chargeState = streamReadInt(',');
+    percent = streamReadInt('\n');
     milliVolts = 0;
     // Wait for final OK
     waitResponse();
@@ -566,7 +567,7 @@ protected:
     if (waitResponse(timeout_ms, GF(GSM_NL "+CIPNUM:")) != 1) {
       return false;
     }
-    int newMux = stream.readStringUntil('\n').toInt();
+    int newMux = streamReadInt('\n');
 
     int rsp = waitResponse((timeout_ms- (millis() - startMillis)),
                            GF("CONNECT OK" GSM_NL),
@@ -586,6 +587,7 @@ protected:
       return 0;
     }
     stream.write((uint8_t*)buff, len);
+    TINY_GSM_AT_STATS_BYTES(len, 0)
     stream.flush();
     if (waitResponse(10000L, GFP(GSM_OK), GF(GSM_NL "FAIL")) != 1) {
       return 0;
@@ -608,7 +610,22 @@ public:
 
 TINY_GSM_MODEM_STREAM_UTILITIES()
 
-  // TODO: Optimize this!
+TINY_GSM_MODEM_MATCHER()
+
+  // URCs handled by waitResponse(), matched alongside the expected responses
+  enum {
+    URC_CIPRCV = TINY_GSM_MATCH_URC,
+    URC_TCPCLOSED
+  };
+
+  static GsmConstStr urcPattern(uint8_t id) {
+    switch (id) {
+      case URC_CIPRCV:    return GF("+CIPRCV:");
+      case URC_TCPCLOSED: return GF("+TCPCLOSED:");
+      default: return NULL;
+    }
+  }
+
   uint8_t waitResponse(uint32_t timeout_ms, String& data,
                        GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
                        GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL)
@@ -620,6 +637,7 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
     String r5s(r5); r5s.trim();
     DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
     data.reserve(64);
+    matcherExpect(r1, r2, r3, r4, r5);
     int index = 0;
     unsigned long startMillis = millis();
     do {
@@ -628,40 +646,31 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
         TINY_GSM_YIELD();
         int a = stream.read();
         if (a <= 0) continue; // Skip 0x00 bytes, just in case
-        data += (char)a;
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
-          goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
+        TINY_GSM_LINE_PUT(data, a)
+        uint8_t hit = matcher.feed(a);
+        if (hit && hit < TINY_GSM_MATCH_URC) {
+          index = hit;
           goto finish;
-        } else if (r3 && data.endsWith(r3)) {
-          index = 3;
-          goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
-          goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
-          goto finish;
-        } else if (data.endsWith(GF("+CIPRCV:"))) {
-          int mux = stream.readStringUntil(',').toInt();
-          int len = stream.readStringUntil(',').toInt();
+        } else if (hit >= match_app_base) {
+          urcDispatch(hit);
+          data = "";
+        } else if (hit == URC_CIPRCV) {
+          int mux = streamReadInt(',');
+          int len = streamReadInt(',');
           int len_orig = len;
           if (len > sockets[mux]->rx.free()) {
             DBG("### Buffer overflow: ", len, "->", sockets[mux]->rx.free());
           } else {
             DBG("### Got: ", len, "->", sockets[mux]->rx.free());
           }
-          while (len--) {
-            TINY_GSM_MODEM_STREAM_TO_MUX_FIFO_WITH_DOUBLE_TIMEOUT
-          }
+          size_t moved = TinyGsmStreamToFifo(stream, sockets[mux]->rx, len, sockets[mux]->_timeout);
+          TINY_GSM_AT_STATS_BYTES(0, moved)
           if (len_orig > sockets[mux]->available()) { // TODO
             DBG("### Fewer characters received than expected: ", sockets[mux]->available(), " vs ", len_orig);
           }
           data = "";
-        } else if (data.endsWith(GF("+TCPCLOSED:"))) {
-          int mux = stream.readStringUntil('\n').toInt();
+        } else if (hit == URC_TCPCLOSED) {
+          int mux = streamReadInt('\n');
           if (mux >= 0 && mux < TINY_GSM_MUX_COUNT) {
             sockets[mux]->sock_connected = false;
           }
@@ -669,9 +678,13 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
           DBG("### Closed: ", mux);
         }
       }
+      if (TINY_GSM_URC_DRAIN_IDLE()) {
+        break;
+      }
     } while (millis() - startMillis < timeout_ms);
 finish:
-    if (!index) {
+    TINY_GSM_AT_STATS_RESULT(index)
+    if (!index && !match_resume) {
       data.trim();
       if (data.length()) {
         DBG("### Unhandled:", data);
@@ -687,8 +700,8 @@ finish:
                        GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
                        GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL)
   {
-    String data;
-    return waitResponse(timeout_ms, data, r1, r2, r3, r4, r5);
+    wait_line = "";
+    return waitResponse(timeout_ms, wait_line, r1, r2, r3, r4, r5);
   }
 
   uint8_t waitResponse(GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
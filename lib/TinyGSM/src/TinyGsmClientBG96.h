@@ -64,8 +64,9 @@ public:
     this->mux = mux;
     sock_available = 0;
     prev_check = 0;
+    poll_interval = TINY_GSM_POLL_MIN_MS;
+    polled = false;
     sock_connected = false;
-    got_data = false;
 
     at->sockets[mux] = this;
 
@@ -111,8 +112,9 @@ private:
   uint8_t         mux;
   uint16_t        sock_available;
   uint32_t        prev_check;
+  uint32_t        poll_interval;
   bool            sock_connected;
-  bool            got_data;
+  bool            polled;
   RxFifo          rx;
 };
 
@@ -139,6 +141,17 @@ private:
 // };
 
 
+/*
+ * Socket opened in transparent access mode (AT+QIOPEN access mode 2): once
+ * connected, payload bytes go over the UART with no QIRD/QISEND round trips.
+ * Other sockets stay open, but no modem functions may be used while a
+ * transparent connection is in data mode.  It uses the connectID given as
+ * mux, closing a regular client on the same one first; stop() releases it
+ * with QICLOSE, also after the remote side closed.
+ */
+TINY_GSM_CLIENT_TRANSPARENT(TinyGsmBG96, "NO CARRIER")
+
+
 public:
 
   TinyGsmBG96(Stream& stream)
@@ -302,6 +315,25 @@ TINY_GSM_MODEM_GET_CSQ()
 
 TINY_GSM_MODEM_WAIT_FOR_NETWORK()
 
+  // Order in which access technologies are scanned, e.g. "020301" for
+  // CAT-M, NB-IoT, then GSM
+  String getScanSequence() {
+    sendAT(GF("+QCFG=\"nwscanseq\""));
+    if (waitResponse(GF(GSM_NL "+QCFG: \"nwscanseq\",")) != 1) {
+      return "";
+    }
+    String res = stream.readStringUntil('\n');
+    res.trim();
+    waitResponse();
+    return res;
+  }
+
+  // Takes effect immediately, without a restart
+  bool setScanSequence(const char* seq) {
+    sendAT(GF("+QCFG=\"nwscanseq\","), seq, GF(",1"));
+    return waitResponse() == 1;
+  }
+
   /*
    * GPRS functions
    */
@@ -457,7 +489,7 @@ TINY_GSM_MODEM_GET_GPRS_IP_CONNECTED()
     streamSkipUntil(','); // Skip battery charge status
     streamSkipUntil(','); // Skip battery charge level
     // return voltage in mV
-    uint16_t res = stream.readStringUntil(',').toInt();
+    uint16_t res = streamReadInt(',');
     // Wait for final OK
     waitResponse();
     return res;
@@ -470,7 +502,7 @@ TINY_GSM_MODEM_GET_GPRS_IP_CONNECTED()
     }
     streamSkipUntil(','); // Skip battery charge status
     // Read battery charge level
-    int res = stream.readStringUntil(',').toInt();
+    int res = streamReadInt(',');
     // Wait for final OK
     waitResponse();
     return res;
@@ -482,7 +514,7 @@ TINY_GSM_MODEM_GET_GPRS_IP_CONNECTED()
       return false;
     }
     // Read battery charge status
-    int res = stream.readStringUntil(',').toInt();
+    int res = streamReadInt(',');
     // Wait for final OK
     waitResponse();
     return res;
@@ -493,9 +525,9 @@ TINY_GSM_MODEM_GET_GPRS_IP_CONNECTED()
     if (waitResponse(GF(GSM_NL "+CBC:")) != 1) {
       return false;
     }
-    chargeState = stream.readStringUntil(',').toInt();
-    percent = stream.readStringUntil(',').toInt();
-    milliVolts = stream.readStringUntil('\n').toInt();
+    chargeState = streamReadInt(',');
+    percent = streamReadInt(',');
+    milliVolts = streamReadInt('\n');
     // Wait for final OK
     waitResponse();
     return true;
@@ -526,21 +558,48 @@ protected:
       return false;
     }
 
-    if (stream.readStringUntil(',').toInt() != mux) {
+    if (streamReadInt(',') != mux) {
       return false;
     }
     // Read status
-    rsp = stream.readStringUntil('\n').toInt();
+    rsp = streamReadInt('\n');
 
     return (0 == rsp);
   }
 
+  bool modemTransparentConnect(const char* host, uint16_t port, uint8_t mux,
+                               int timeout_s = 20) {
+    uint32_t timeout_ms = ((uint32_t)timeout_s) * 1000;
+    // Unlike NETCLOSE on other modems, nothing here closes the regular
+    // sockets, so one may still hold this connectID
+    if (mux < TINY_GSM_MUX_COUNT && sockets[mux] && sockets[mux]->sock_connected) {
+      sockets[mux]->stop();
+    }
+    // Access mode 2 answers CONNECT once the socket is open
+    sendAT(GF("+QIOPEN=1,"), mux, ',', GF("\"TCP"), GF("\",\""), host, GF("\","), port, GF(",0,2"));
+    return waitResponse(timeout_ms, GF(GSM_NL "CONNECT" GSM_NL), GFP(GSM_ERROR)) == 1;
+  }
+
+  void modemTransparentClose(uint8_t mux, bool data_mode) {
+    if (data_mode) {
+      // Escape sequence needs a second of silence before and half after
+      delay(1000);
+      stream.print(GF("+++"));
+      stream.flush();
+      delay(500);
+      waitResponse();
+    }
+    sendAT(GF("+QICLOSE="), mux);
+    waitResponse();
+  }
+
   int16_t modemSend(const void* buff, size_t len, uint8_t mux) {
     sendAT(GF("+QISEND="), mux, ',', (uint16_t)len);
     if (waitResponse(GF(">")) != 1) {
       return 0;
     }
     stream.write((uint8_t*)buff, len);
+    TINY_GSM_AT_STATS_BYTES(len, 0)
     stream.flush();
     if (waitResponse(GF(GSM_NL "SEND OK")) != 1) {
       return 0;
@@ -554,13 +613,13 @@ protected:
     if (waitResponse(GF("+QIRD:")) != 1) {
       return 0;
     }
-    int len = stream.readStringUntil('\n').toInt();
+    int len = streamReadInt('\n');
 
-    for (int i=0; i<len; i++) {
-      TINY_GSM_MODEM_STREAM_TO_MUX_FIFO_WITH_DOUBLE_TIMEOUT
-    }
+    size_t moved = TinyGsmStreamToFifo(stream, sockets[mux]->rx, len, sockets[mux]->_timeout);
+
+    TINY_GSM_AT_STATS_BYTES(0, moved)
     waitResponse();
-    DBG("### READ:", len, "from", mux);
+    DBG_TRACE(GF("### READ:"), len, GF("from"), mux);
     sockets[mux]->sock_available = modemGetAvailable(mux);
     return len;
   }
@@ -571,7 +630,7 @@ protected:
     if (waitResponse(GF("+QIRD:")) == 1) {
       streamSkipUntil(','); // Skip total received
       streamSkipUntil(','); // Skip have read
-      result = stream.readStringUntil('\n').toInt();
+      result = streamReadInt('\n');
       if (result) {
         DBG("### DATA AVAILABLE:", result, "on", mux);
       }
@@ -595,7 +654,7 @@ protected:
     streamSkipUntil(','); // Skip remote ip
     streamSkipUntil(','); // Skip remote port
     streamSkipUntil(','); // Skip local port
-    int res = stream.readStringUntil(',').toInt(); // socket state
+    int res = streamReadInt(','); // socket state
 
     waitResponse();
 
@@ -611,7 +670,20 @@ public:
 
 TINY_GSM_MODEM_STREAM_UTILITIES()
 
-  // TODO: Optimize this!
+TINY_GSM_MODEM_MATCHER()
+
+  // URCs handled by waitResponse(), matched alongside the expected responses
+  enum {
+    URC_QIURC = TINY_GSM_MATCH_URC
+  };
+
+  static GsmConstStr urcPattern(uint8_t id) {
+    switch (id) {
+      case URC_QIURC: return GF(GSM_NL "+QIURC:");
+      default: return NULL;
+    }
+  }
+
   uint8_t waitResponse(uint32_t timeout_ms, String& data,
                        GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
                        GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL)
@@ -623,6 +695,7 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
     String r5s(r5); r5s.trim();
     DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
     data.reserve(64);
+    matcherExpect(r1, r2, r3, r4, r5);
     int index = 0;
     unsigned long startMillis = millis();
     do {
@@ -631,47 +704,44 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
         TINY_GSM_YIELD();
         int a = stream.read();
         if (a <= 0) continue; // Skip 0x00 bytes, just in case
-        data += (char)a;
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
-          goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
-          goto finish;
-        } else if (r3 && data.endsWith(r3)) {
-          index = 3;
+        TINY_GSM_LINE_PUT(data, a)
+        uint8_t hit = matcher.feed(a);
+        if (hit && hit < TINY_GSM_MATCH_URC) {
+          index = hit;
           goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
-          goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
-          goto finish;
-        } else if (data.endsWith(GF(GSM_NL "+QIURC:"))) {
-          stream.readStringUntil('\"');
-          String urc = stream.readStringUntil('\"');
-          stream.readStringUntil(',');
-          if (urc == "recv") {
-            int mux = stream.readStringUntil('\n').toInt();
+        } else if (hit >= match_app_base) {
+          urcDispatch(hit);
+          data = "";
+        } else if (hit == URC_QIURC) {
+          char urc[8];
+          streamSkipUntil('\"');
+          streamReadToken(urc, sizeof(urc), '\"');
+          streamSkipUntil(',');
+          if (!strcmp(urc, "recv")) {
+            int mux = streamReadInt('\n');
             DBG("### URC RECV:", mux);
             if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-              sockets[mux]->got_data = true;
+              sock_pending |= TINY_GSM_SOCK_BIT(mux);
             }
-          } else if (urc == "closed") {
-            int mux = stream.readStringUntil('\n').toInt();
+          } else if (!strcmp(urc, "closed")) {
+            int mux = streamReadInt('\n');
             DBG("### URC CLOSE:", mux);
             if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
               sockets[mux]->sock_connected = false;
             }
           } else {
-            stream.readStringUntil('\n');
+            streamSkipUntil('\n');
           }
           data = "";
         }
       }
+      if (TINY_GSM_URC_DRAIN_IDLE()) {
+        break;
+      }
     } while (millis() - startMillis < timeout_ms);
 finish:
-    if (!index) {
+    TINY_GSM_AT_STATS_RESULT(index)
+    if (!index && !match_resume) {
       data.trim();
       if (data.length()) {
         DBG("### Unhandled:", data);
@@ -687,8 +757,8 @@ finish:
                        GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
                        GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL)
   {
-    String data;
-    return waitResponse(timeout_ms, data, r1, r2, r3, r4, r5);
+    wait_line = "";
+    return waitResponse(timeout_ms, wait_line, r1, r2, r3, r4, r5);
   }
 
   uint8_t waitResponse(GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
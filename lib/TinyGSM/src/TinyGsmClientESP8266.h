@@ -81,6 +81,7 @@ TINY_GSM_CLIENT_CONNECT_OVERLOADS()
 
   virtual void stop(uint32_t maxWaitMs) {
     TINY_GSM_YIELD();
+    TINY_GSM_CLIENT_TX_FINISH()
     at->sendAT(GF("+CIPCLOSE="), mux);
     sock_connected = false;
     at->waitResponse(maxWaitMs);
@@ -373,14 +374,19 @@ protected:
     return (1 == rsp);
   }
 
+  // Always waits for SEND OK: until it comes the ESP8266 answers every
+  // command, another CIPSEND included, with "busy s...", so there is no
+  // send window here
   int16_t modemSend(const void* buff, size_t len, uint8_t mux) {
     sendAT(GF("+CIPSEND="), mux, ',', (uint16_t)len);
     if (waitResponse(GF(">")) != 1) {
       return 0;
     }
     stream.write((uint8_t*)buff, len);
+    TINY_GSM_AT_STATS_BYTES(len, 0)
     stream.flush();
-    if (waitResponse(10000L, GF(GSM_NL "SEND OK" GSM_NL)) != 1) {
+    if (waitResponse(10000L, GF(GSM_NL "SEND OK" GSM_NL),
+                     GF(GSM_NL "SEND FAIL" GSM_NL)) != 1) {
       return 0;
     }
     return len;
@@ -403,7 +409,7 @@ protected:
     for (int muxNo = 0; muxNo < TINY_GSM_MUX_COUNT; muxNo++) {
       uint8_t has_status = waitResponse(GF("+CIPSTATUS:"), GFP(GSM_OK), GFP(GSM_ERROR));
       if (has_status == 1) {
-        int returned_mux = stream.readStringUntil(',').toInt();
+        int returned_mux = streamReadInt(',');
         streamSkipUntil(',');  // Skip mux
         streamSkipUntil(',');  // Skip type
         streamSkipUntil(',');  // Skip remote IP
@@ -428,7 +434,22 @@ public:
 
 TINY_GSM_MODEM_STREAM_UTILITIES()
 
-  // TODO: Optimize this!
+TINY_GSM_MODEM_MATCHER()
+
+  // URCs handled by waitResponse(), matched alongside the expected responses
+  enum {
+    URC_IPD = TINY_GSM_MATCH_URC,
+    URC_CLOSED
+  };
+
+  static GsmConstStr urcPattern(uint8_t id) {
+    switch (id) {
+      case URC_IPD:       return GF("+IPD,");
+      case URC_CLOSED:    return GF("CLOSED");
+      default: return NULL;
+    }
+  }
+
   uint8_t waitResponse(uint32_t timeout_ms, String& data,
                        GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
                        GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL)
@@ -440,6 +461,7 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
     String r5s(r5); r5s.trim();
     DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
     data.reserve(64);
+    matcherExpect(r1, r2, r3, r4, r5);
     int index = 0;
     unsigned long startMillis = millis();
     do {
@@ -448,42 +470,31 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
         TINY_GSM_YIELD();
         int a = stream.read();
         if (a <= 0) continue; // Skip 0x00 bytes, just in case
-        data += (char)a;
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
-          goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
+        TINY_GSM_LINE_PUT(data, a)
+        uint8_t hit = matcher.feed(a);
+        if (hit && hit < TINY_GSM_MATCH_URC) {
+          index = hit;
           goto finish;
-        } else if (r3 && data.endsWith(r3)) {
-          index = 3;
-          goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
-          goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
-          goto finish;
-        } else if (data.endsWith(GF("+IPD,"))) {
-          int mux = stream.readStringUntil(',').toInt();
-          int len = stream.readStringUntil(':').toInt();
+        } else if (hit >= match_app_base) {
+          urcDispatch(hit);
+          data = "";
+        } else if (hit == URC_IPD) {
+          int mux = streamReadInt(',');
+          int len = streamReadInt(':');
           int len_orig = len;
           if (len > sockets[mux]->rx.free()) {
             DBG("### Buffer overflow: ", len, "received vs", sockets[mux]->rx.free(), "available");
           } else {
-            DBG("### Got Data: ", len, "on", mux);
-          }
-          while (len--) {
-            TINY_GSM_MODEM_STREAM_TO_MUX_FIFO_WITH_DOUBLE_TIMEOUT
+            DBG_TRACE(GF("### Got Data: "), len, GF("on"), mux);
           }
+          size_t moved = TinyGsmStreamToFifo(stream, sockets[mux]->rx, len, sockets[mux]->_timeout);
+          TINY_GSM_AT_STATS_BYTES(0, moved)
           if (len_orig > sockets[mux]->available()) { // TODO
             DBG("### Fewer characters received than expected: ", sockets[mux]->available(), " vs ", len_orig);
           }
           data = "";
-        } else if (data.endsWith(GF("CLOSED"))) {
-          int muxStart = max(0,data.lastIndexOf(GSM_NL, data.length()-8));
-          int coma = data.indexOf(',', muxStart);
-          int mux = data.substring(muxStart, coma).toInt();
+        } else if (hit == URC_CLOSED) {
+          int mux = TinyGsmUrcMux(data, 8);
           if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
             sockets[mux]->sock_connected = false;
           }
@@ -491,9 +502,13 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
           DBG("### Closed: ", mux);
         }
       }
+      if (TINY_GSM_URC_DRAIN_IDLE()) {
+        break;
+      }
     } while (millis() - startMillis < timeout_ms);
 finish:
-    if (!index) {
+    TINY_GSM_AT_STATS_RESULT(index)
+    if (!index && !match_resume) {
       data.trim();
       if (data.length()) {
         DBG("### Unhandled:", data);
@@ -509,8 +524,8 @@ finish:
                        GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
                        GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL)
   {
-    String data;
-    return waitResponse(timeout_ms, data, r1, r2, r3, r4, r5);
+    wait_line = "";
+    return waitResponse(timeout_ms, wait_line, r1, r2, r3, r4, r5);
   }
 
   uint8_t waitResponse(GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
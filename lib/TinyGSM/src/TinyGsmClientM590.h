@@ -83,6 +83,7 @@ TINY_GSM_CLIENT_CONNECT_OVERLOADS()
 
   virtual void stop(uint32_t maxWaitMs) {
     TINY_GSM_YIELD();
+    TINY_GSM_CLIENT_TX_FINISH()
     at->sendAT(GF("+TCPCLOSE="), mux);
     sock_connected = false;
     at->waitResponse(maxWaitMs);
@@ -329,7 +330,7 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     if (waitResponse(GF(GSM_NL "+XIIC:")) != 1) {
       return false;
     }
-    int res = stream.readStringUntil(',').toInt();
+    int res = streamReadInt(',');
     waitResponse();
     return res == 1;
   }
@@ -382,7 +383,7 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     stream.readStringUntil('"');
     String hex = stream.readStringUntil('"');
     stream.readStringUntil(',');
-    int dcs = stream.readStringUntil('\n').toInt();
+    int dcs = streamReadInt('\n');
 
     if (waitResponse() != 1) {
       return "";
@@ -464,6 +465,7 @@ protected:
       return 0;
     }
     stream.write((uint8_t*)buff, len);
+    TINY_GSM_AT_STATS_BYTES(len, 0)
     stream.write((char)0x0D);
     stream.flush();
     if (waitResponse(30000L, GF(GSM_NL "+TCPSEND:")) != 1) {
@@ -499,7 +501,22 @@ public:
 
 TINY_GSM_MODEM_STREAM_UTILITIES()
 
-  // TODO: Optimize this!
+TINY_GSM_MODEM_MATCHER()
+
+  // URCs handled by waitResponse(), matched alongside the expected responses
+  enum {
+    URC_TCPRECV = TINY_GSM_MATCH_URC,
+    URC_TCPCLOSE
+  };
+
+  static GsmConstStr urcPattern(uint8_t id) {
+    switch (id) {
+      case URC_TCPRECV:  return GF("+TCPRECV:");
+      case URC_TCPCLOSE: return GF("+TCPCLOSE:");
+      default: return NULL;
+    }
+  }
+
   uint8_t waitResponse(uint32_t timeout_ms, String& data,
                        GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
                        GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL)
@@ -511,6 +528,7 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
     String r5s(r5); r5s.trim();
     DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
     data.reserve(64);
+    matcherExpect(r1, r2, r3, r4, r5);
     int index = 0;
     unsigned long startMillis = millis();
     do {
@@ -519,41 +537,32 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
         TINY_GSM_YIELD();
         int a = stream.read();
         if (a <= 0) continue; // Skip 0x00 bytes, just in case
-        data += (char)a;
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
-          goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
+        TINY_GSM_LINE_PUT(data, a)
+        uint8_t hit = matcher.feed(a);
+        if (hit && hit < TINY_GSM_MATCH_URC) {
+          index = hit;
           goto finish;
-        } else if (r3 && data.endsWith(r3)) {
-          index = 3;
-          goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
-          goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
-          goto finish;
-        } else if (data.endsWith(GF("+TCPRECV:"))) {
-          int mux = stream.readStringUntil(',').toInt();
-          int len = stream.readStringUntil(',').toInt();
+        } else if (hit >= match_app_base) {
+          urcDispatch(hit);
+          data = "";
+        } else if (hit == URC_TCPRECV) {
+          int mux = streamReadInt(',');
+          int len = streamReadInt(',');
           int len_orig = len;
           if (len > sockets[mux]->rx.free()) {
             DBG("### Buffer overflow: ", len, "->", sockets[mux]->rx.free());
           } else {
             DBG("### Got: ", len, "->", sockets[mux]->rx.free());
           }
-          while (len--) {
-            TINY_GSM_MODEM_STREAM_TO_MUX_FIFO_WITH_DOUBLE_TIMEOUT
-          }
+          size_t moved = TinyGsmStreamToFifo(stream, sockets[mux]->rx, len, sockets[mux]->_timeout);
+          TINY_GSM_AT_STATS_BYTES(0, moved)
           if (len_orig > sockets[mux]->available()) { // TODO
             DBG("### Fewer characters received than expected: ", sockets[mux]->available(), " vs ", len_orig);
           }
           data = "";
-        } else if (data.endsWith(GF("+TCPCLOSE:"))) {
-          int mux = stream.readStringUntil(',').toInt();
-          stream.readStringUntil('\n');
+        } else if (hit == URC_TCPCLOSE) {
+          int mux = streamReadInt(',');
+          streamSkipUntil('\n');
           if (mux >= 0 && mux < TINY_GSM_MUX_COUNT) {
             sockets[mux]->sock_connected = false;
           }
@@ -561,9 +570,13 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
           DBG("### Closed: ", mux);
         }
       }
+      if (TINY_GSM_URC_DRAIN_IDLE()) {
+        break;
+      }
     } while (millis() - startMillis < timeout_ms);
 finish:
-    if (!index) {
+    TINY_GSM_AT_STATS_RESULT(index)
+    if (!index && !match_resume) {
       data.trim();
       if (data.length()) {
         DBG("### Unhandled:", data);
@@ -579,8 +592,8 @@ finish:
                        GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
                        GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL)
   {
-    String data;
-    return waitResponse(timeout_ms, data, r1, r2, r3, r4, r5);
+    wait_line = "";
+    return waitResponse(timeout_ms, wait_line, r1, r2, r3, r4, r5);
   }
 
   uint8_t waitResponse(GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
@@ -445,7 +445,7 @@ TINY_GSM_MODEM_GET_GPRS_IP_CONNECTED()
     stream.readStringUntil('"');
     String hex = stream.readStringUntil('"');
     stream.readStringUntil(',');
-    int dcs = stream.readStringUntil('\n').toInt();
+    int dcs = streamReadInt('\n');
 
     if (waitResponse() != 1) {
       return "";
@@ -540,7 +540,7 @@ TINY_GSM_MODEM_GET_GPRS_IP_CONNECTED()
     streamSkipUntil(','); // Skip battery charge status
     streamSkipUntil(','); // Skip battery charge level
     // return voltage in mV
-    uint16_t res = stream.readStringUntil(',').toInt();
+    uint16_t res = streamReadInt(',');
     // Wait for final OK
     waitResponse();
     return res;
@@ -553,7 +553,7 @@ TINY_GSM_MODEM_GET_GPRS_IP_CONNECTED()
     }
     streamSkipUntil(','); // Skip battery charge status
     // Read battery charge level
-    int res = stream.readStringUntil(',').toInt();
+    int res = streamReadInt(',');
     // Wait for final OK
     waitResponse();
     return res;
@@ -565,7 +565,7 @@ TINY_GSM_MODEM_GET_GPRS_IP_CONNECTED()
       return false;
     }
     // Read battery charge status
-    int res = stream.readStringUntil(',').toInt();
+    int res = streamReadInt(',');
     // Wait for final OK
     waitResponse();
     return res;
@@ -576,9 +576,9 @@ TINY_GSM_MODEM_GET_GPRS_IP_CONNECTED()
     if (waitResponse(GF(GSM_NL "+CBC:")) != 1) {
       return false;
     }
-    chargeState = stream.readStringUntil(',').toInt();
-    percent = stream.readStringUntil(',').toInt();
-    milliVolts = stream.readStringUntil('\n').toInt();
+    chargeState = streamReadInt(',');
+    percent = streamReadInt(',');
+    milliVolts = streamReadInt('\n');
     // Wait for final OK
     waitResponse();
     return true;
@@ -591,7 +591,7 @@ TINY_GSM_MODEM_GET_GPRS_IP_CONNECTED()
     }
     streamSkipUntil(','); // Skip mode
     // Read charge of thermistor
-    // milliVolts = stream.readStringUntil(',').toInt();
+    // milliVolts = streamReadInt(',');
     streamSkipUntil(','); // Skip thermistor charge
     float temp = stream.readStringUntil('\n').toFloat();
     // Wait for final OK
@@ -625,6 +625,7 @@ protected:
       return 0;
     }
     stream.write((uint8_t*)buff, len);
+    TINY_GSM_AT_STATS_BYTES(len, 0)
     stream.flush();
     if (waitResponse(GF(GSM_NL "SEND OK")) != 1) {
       return 0;
@@ -640,7 +641,7 @@ protected:
     //     streamSkipUntil(',');  // Skip total length sent on connection
     //     streamSkipUntil(',');  // Skip length already acknowledged by remote
     //     // Make sure the total length un-acknowledged is 0
-    //     if ( stream.readStringUntil('\n').toInt() == 0 ) {
+    //     if ( streamReadInt('\n') == 0 ) {
     //       allAcknowledged = true;
     //     }
     //   }
@@ -666,7 +667,7 @@ protected:
       streamSkipUntil(',');  // skip port
       streamSkipUntil(',');  // skip connection type (TCP/UDP)
       // read the real length of the retrieved data
-      uint16_t len = stream.readStringUntil('\n').toInt();
+      uint16_t len = streamReadInt('\n');
       // We have no way of knowing in advance how much data will be in the buffer
       // so when data is received we always assume the buffer is completely full.
       // Chances are, this is not true and there's really not that much there.
@@ -674,13 +675,12 @@ protected:
       if (len < size) {
           sockets[mux]->sock_available = len;
       }
-      for (uint16_t i=0; i<len; i++) {
-        TINY_GSM_MODEM_STREAM_TO_MUX_FIFO_WITH_DOUBLE_TIMEOUT
-        sockets[mux]->sock_available--;
-        // ^^ One less character available after moving from modem's FIFO to our FIFO
-      }
+      size_t moved = TinyGsmStreamToFifo(stream, sockets[mux]->rx, len, sockets[mux]->_timeout);
+      TINY_GSM_AT_STATS_BYTES(0, moved)
+      sockets[mux]->sock_available -= TinyGsmMin((size_t)sockets[mux]->sock_available, moved);
+      // ^^ Fewer characters available after moving from modem's FIFO to our FIFO
       waitResponse();  // ends with an OK
-      DBG("### READ:", len, "from", mux);
+      DBG_TRACE(GF("### READ:"), len, GF("from"), mux);
       return len;
     } else {
         sockets[mux]->sock_available = 0;
@@ -700,7 +700,7 @@ protected:
     streamSkipUntil(','); // Skip remote ip
     streamSkipUntil(','); // Skip remote port
     streamSkipUntil(','); // Skip local port
-    int res = stream.readStringUntil(',').toInt(); // socket state
+    int res = streamReadInt(','); // socket state
 
     waitResponse();
 
@@ -716,7 +716,22 @@ public:
 
 TINY_GSM_MODEM_STREAM_UTILITIES()
 
-  // TODO: Optimize this!
+TINY_GSM_MODEM_MATCHER()
+
+  // URCs handled by waitResponse(), matched alongside the expected responses
+  enum {
+    URC_QIRDI = TINY_GSM_MATCH_URC,
+    URC_CLOSED
+  };
+
+  static GsmConstStr urcPattern(uint8_t id) {
+    switch (id) {
+      case URC_QIRDI:  return GF(GSM_NL "+QIRDI:");
+      case URC_CLOSED: return GF("CLOSED" GSM_NL);
+      default: return NULL;
+    }
+  }
+
   uint8_t waitResponse(uint32_t timeout_ms, String& data,
                        GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
                        GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL)
@@ -728,6 +743,7 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
     String r5s(r5); r5s.trim();
     DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
     data.reserve(64);
+    matcherExpect(r1, r2, r3, r4, r5);
     int index = 0;
     unsigned long startMillis = millis();
     do {
@@ -736,37 +752,27 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
         TINY_GSM_YIELD();
         int a = stream.read();
         if (a <= 0) continue; // Skip 0x00 bytes, just in case
-        data += (char)a;
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
+        TINY_GSM_LINE_PUT(data, a)
+        uint8_t hit = matcher.feed(a);
+        if (hit && hit < TINY_GSM_MATCH_URC) {
+          index = hit;
           goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
-          goto finish;
-        } else if (r3 && data.endsWith(r3)) {
-          index = 3;
-          goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
-          goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
-          goto finish;
-        } else if (data.endsWith(GF(GSM_NL "+QIRDI:"))) {
+        } else if (hit >= match_app_base) {
+          urcDispatch(hit);
+          data = "";
+        } else if (hit == URC_QIRDI) {
           streamSkipUntil(',');  // Skip the context
           streamSkipUntil(',');  // Skip the role
-          int mux = stream.readStringUntil('\n').toInt();
-          DBG("### Got Data:", mux);
+          int mux = streamReadInt('\n');
+          DBG_TRACE(GF("### Got Data:"), mux);
           if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
             // We have no way of knowing how much data actually came in, so
             // we set the value to 1500, the maximum possible size.
             sockets[mux]->sock_available = 1500;
           }
           data = "";
-        } else if (data.endsWith(GF("CLOSED" GSM_NL))) {
-          int nl = data.lastIndexOf(GSM_NL, data.length()-8);
-          int coma = data.indexOf(',', nl+2);
-          int mux = data.substring(nl+2, coma).toInt();
+        } else if (hit == URC_CLOSED) {
+          int mux = TinyGsmUrcMux(data, 8);
           if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
             sockets[mux]->sock_connected = false;
           }
@@ -774,9 +780,13 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
           DBG("### Closed: ", mux);
         }
       }
+      if (TINY_GSM_URC_DRAIN_IDLE()) {
+        break;
+      }
     } while (millis() - startMillis < timeout_ms);
 finish:
-    if (!index) {
+    TINY_GSM_AT_STATS_RESULT(index)
+    if (!index && !match_resume) {
       data.trim();
       if (data.length()) {
         DBG("### Unhandled:", data);
@@ -792,8 +802,8 @@ finish:
                        GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
                        GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL)
   {
-    String data;
-    return waitResponse(timeout_ms, data, r1, r2, r3, r4, r5);
+    wait_line = "";
+    return waitResponse(timeout_ms, wait_line, r1, r2, r3, r4, r5);
   }
 
   uint8_t waitResponse(GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
@@ -429,7 +429,7 @@ TINY_GSM_MODEM_GET_GPRS_IP_CONNECTED()
     stream.readStringUntil('"');
     String hex = stream.readStringUntil('"');
     stream.readStringUntil(',');
-    int dcs = stream.readStringUntil('\n').toInt();
+    int dcs = streamReadInt('\n');
 
     if (waitResponse() != 1) {
       return "";
@@ -524,7 +524,7 @@ TINY_GSM_MODEM_GET_GPRS_IP_CONNECTED()
     streamSkipUntil(','); // Skip battery charge status
     streamSkipUntil(','); // Skip battery charge level
     // return voltage in mV
-    uint16_t res = stream.readStringUntil(',').toInt();
+    uint16_t res = streamReadInt(',');
     // Wait for final OK
     waitResponse();
     return res;
@@ -537,7 +537,7 @@ TINY_GSM_MODEM_GET_GPRS_IP_CONNECTED()
     }
     streamSkipUntil(','); // Skip battery charge status
     // Read battery charge level
-    int res = stream.readStringUntil(',').toInt();
+    int res = streamReadInt(',');
     // Wait for final OK
     waitResponse();
     return res;
@@ -549,7 +549,7 @@ TINY_GSM_MODEM_GET_GPRS_IP_CONNECTED()
       return false;
     }
     // Read battery charge status
-    int res = stream.readStringUntil(',').toInt();
+    int res = streamReadInt(',');
     // Wait for final OK
     waitResponse();
     return res;
@@ -560,9 +560,9 @@ TINY_GSM_MODEM_GET_GPRS_IP_CONNECTED()
     if (waitResponse(GF(GSM_NL "+CBC:")) != 1) {
       return false;
     }
-    chargeState = stream.readStringUntil(',').toInt();
-    percent = stream.readStringUntil(',').toInt();
-    milliVolts = stream.readStringUntil('\n').toInt();
+    chargeState = streamReadInt(',');
+    percent = streamReadInt(',');
+    milliVolts = streamReadInt('\n');
     // Wait for final OK
     waitResponse();
     return true;
@@ -596,6 +596,7 @@ protected:
       return 0;
     }
     stream.write((uint8_t*)buff, len);
+    TINY_GSM_AT_STATS_BYTES(len, 0)
     stream.flush();
     if (waitResponse(GF(GSM_NL "SEND OK")) != 1) {
       return 0;
@@ -610,7 +611,7 @@ protected:
       } else {
         streamSkipUntil(','); /** Skip total */
         streamSkipUntil(','); /** Skip acknowledged data size */
-        if ( stream.readStringUntil('\n').toInt() == 0 ) {
+        if ( streamReadInt('\n') == 0 ) {
           allAcknowledged = true;
         }
       }
@@ -618,7 +619,7 @@ protected:
     waitResponse(5000L);
 
     // streamSkipUntil(','); // Skip mux
-    // return stream.readStringUntil('\n').toInt();
+    // return streamReadInt('\n');
 
     return len;  // TODO
   }
@@ -639,7 +640,7 @@ protected:
       streamSkipUntil(',');  // skip port
       streamSkipUntil(',');  // skip connection type (TCP/UDP)
       // read the real length of the retrieved data
-      uint16_t len = stream.readStringUntil('\n').toInt();
+      uint16_t len = streamReadInt('\n');
       // It's possible that the real length available is less than expected
       // This is quite likely if the buffer is broken into packets - which may
       // be different sizes.
@@ -647,13 +648,12 @@ protected:
       if (len < size) {
           sockets[mux]->sock_available = len;
       }
-      for (uint16_t i=0; i<len; i++) {
-        TINY_GSM_MODEM_STREAM_TO_MUX_FIFO_WITH_DOUBLE_TIMEOUT
-        sockets[mux]->sock_available--;
-        // ^^ One less character available after moving from modem's FIFO to our FIFO
-      }
+      size_t moved = TinyGsmStreamToFifo(stream, sockets[mux]->rx, len, sockets[mux]->_timeout);
+      TINY_GSM_AT_STATS_BYTES(0, moved)
+      sockets[mux]->sock_available -= TinyGsmMin((size_t)sockets[mux]->sock_available, moved);
+      // ^^ Fewer characters available after moving from modem's FIFO to our FIFO
       waitResponse();
-      DBG("### READ:", len, "from", mux);
+      DBG_TRACE(GF("### READ:"), len, GF("from"), mux);
       return len;
     } else {
         sockets[mux]->sock_available = 0;
@@ -673,7 +673,7 @@ protected:
     streamSkipUntil(','); // Skip remote ip
     streamSkipUntil(','); // Skip remote port
     streamSkipUntil(','); // Skip local port
-    int res = stream.readStringUntil(',').toInt(); // socket state
+    int res = streamReadInt(','); // socket state
 
     waitResponse();
 
@@ -689,7 +689,22 @@ public:
 
 TINY_GSM_MODEM_STREAM_UTILITIES()
 
-  // TODO: Optimize this!
+TINY_GSM_MODEM_MATCHER()
+
+  // URCs handled by waitResponse(), matched alongside the expected responses
+  enum {
+    URC_QIRD = TINY_GSM_MATCH_URC,
+    URC_CLOSED
+  };
+
+  static GsmConstStr urcPattern(uint8_t id) {
+    switch (id) {
+      case URC_QIRD:   return GF(GSM_NL "+QIRD:");  // TODO:  QIRD? or QIRDI?
+      case URC_CLOSED: return GF("CLOSED" GSM_NL);
+      default: return NULL;
+    }
+  }
+
   uint8_t waitResponse(uint32_t timeout_ms, String& data,
                        GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
                        GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL, GsmConstStr r6=NULL)
@@ -702,6 +717,7 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
     String r6s(r6); r6s.trim();
     DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s, ",", r6s);*/
     data.reserve(64);
+    matcherExpect(r1, r2, r3, r4, r5, r6);
     int index = 0;
     unsigned long startMillis = millis();
     do {
@@ -710,44 +726,31 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
         TINY_GSM_YIELD();
         int a = stream.read();
         if (a <= 0) continue; // Skip 0x00 bytes, just in case
-        data += (char)a;
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
-          goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
+        TINY_GSM_LINE_PUT(data, a)
+        uint8_t hit = matcher.feed(a);
+        if (hit && hit < TINY_GSM_MATCH_URC) {
+          index = hit;
           goto finish;
-        } else if (r3 && data.endsWith(r3)) {
-          index = 3;
-          goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
-          goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
-          goto finish;
-        } else if (r6 && data.endsWith(r6)) {
-          index = 6;
-          goto finish;
-        } else if (data.endsWith(GF(GSM_NL "+QIRD:"))) {  // TODO:  QIRD? or QIRDI?
+        } else if (hit >= match_app_base) {
+          urcDispatch(hit);
+          data = "";
+        } else if (hit == URC_QIRD) {
           // +QIRDI: <id>,<sc>,<sid>,<num>,<len>,< tlen>
           streamSkipUntil(',');  // Skip the context
           streamSkipUntil(',');  // Skip the role
           // read the connection id
-          int mux = stream.readStringUntil(',').toInt();
+          int mux = streamReadInt(',');
           // read the number of packets in the buffer
-          int num_packets = stream.readStringUntil(',').toInt();
+          int num_packets = streamReadInt(',');
           // read the length of the current packet
-          int len_packet = stream.readStringUntil('\n').toInt();
+          int len_packet = streamReadInt('\n');
           if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
             sockets[mux]->sock_available = len_packet*num_packets;
           }
           data = "";
-          DBG("### Got Data:", len, "on", mux);
-        } else if (data.endsWith(GF("CLOSED" GSM_NL))) {
-          int nl = data.lastIndexOf(GSM_NL, data.length()-8);
-          int coma = data.indexOf(',', nl+2);
-          int mux = data.substring(nl+2, coma).toInt();
+          DBG_TRACE(GF("### Got Data:"), len_packet, GF("on"), mux);
+        } else if (hit == URC_CLOSED) {
+          int mux = TinyGsmUrcMux(data, 8);
           if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
             sockets[mux]->sock_connected = false;
           }
@@ -755,9 +758,13 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
           DBG("### Closed: ", mux);
         }
       }
+      if (TINY_GSM_URC_DRAIN_IDLE()) {
+        break;
+      }
     } while (millis() - startMillis < timeout_ms);
 finish:
-    if (!index) {
+    TINY_GSM_AT_STATS_RESULT(index)
+    if (!index && !match_resume) {
       data.trim();
       if (data.length()) {
         DBG("### Unhandled:", data);
@@ -773,8 +780,8 @@ finish:
                        GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
                        GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL, GsmConstStr r6=NULL)
   {
-    String data;
-    return waitResponse(timeout_ms, data, r1, r2, r3, r4, r5, r6);
+    wait_line = "";
+    return waitResponse(timeout_ms, wait_line, r1, r2, r3, r4, r5, r6);
   }
 
   uint8_t waitResponse(GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
@@ -0,0 +1,223 @@
+/**
+ * @file       TinyGsmClientPool.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Nov 2016
+ */
+
+#ifndef TinyGsmClientPool_h
+#define TinyGsmClientPool_h
+
+#include <Arduino.h>
+#include <Client.h>
+
+// Number of the modem's sockets the pool owns, from mux first up.  Include
+// this after TinyGsmClient.h.
+#ifndef TINY_GSM_POOL_SLOTS
+  #define TINY_GSM_POOL_SLOTS TINY_GSM_MUX_COUNT
+#endif
+
+#ifndef TINY_GSM_POOL_HOST
+  #define TINY_GSM_POOL_HOST 64
+#endif
+
+// Keeps connections open between requests, one per modem socket, so that
+// a request to a server that was talked to before reuses the connection
+// instead of paying for CIPSTART (and a TLS handshake) again.
+//
+// acquire() hands out an idle connection to the same host and port once
+// the modem confirms it is still up, or opens one on a free socket, closing
+// the one idle the longest if there is none.  release() gives it back.
+// The pool owns its sockets: don't make other clients on the same muxes.
+// Anything that shuts the modem's IP stack, like a transparent mode
+// connection, must be preceded by closeAll().
+//
+// Secure connections are made by a factory, called with the slot's plain
+// socket whenever one is opened; it returns the client to use over it, e.g.
+// a TinyGsmClientTls kept per slot, which then resumes its last session.
+// Socket can also be the modem's GsmClientSecure, to pool connections
+// secured by the modem itself.
+template <class Modem, class Socket = typename Modem::GsmClient>
+class TinyGsmClientPool
+{
+public:
+    typedef Client* (*SecureFactory)(uint8_t slot, Client& socket,
+                                     const char* host, void* ctx);
+
+    TinyGsmClientPool(Modem& modem, uint8_t first = 0)
+    {
+        _secure = NULL;
+        _secureCtx = NULL;
+        _hits = _misses = 0;
+        for (uint8_t i = 0; i < TINY_GSM_POOL_SLOTS; i++)
+        {
+            _slot[i].sock.init(&modem, first + i);
+            _slot[i].conn = NULL;
+            _slot[i].secure = false;
+            _slot[i].busy = false;
+            _slot[i].host[0] = '\0';
+            _slot[i].port = 0;
+            _slot[i].idleSince = 0;
+        }
+    }
+
+    void setSecureFactory(SecureFactory factory, void* ctx = NULL)
+    {
+        _secure = factory;
+        _secureCtx = ctx;
+    }
+
+    // A connection to host:port, or NULL if none could be made.  With an
+    // address other than 0.0.0.0 a new connection is opened by address,
+    // host still tells pooled connections apart.
+    Client* acquire(const char* host, uint16_t port, bool secure = false,
+                    IPAddress ip = IPAddress(0, 0, 0, 0))
+    {
+        if (secure && !_secure)
+            return NULL;
+
+        uint32_t now = millis();
+        int8_t reuse = -1, fresh = -1;
+        for (uint8_t i = 0; i < TINY_GSM_POOL_SLOTS; i++)
+        {
+            Slot& s = _slot[i];
+            if (s.busy)
+                continue;
+            if (s.conn && s.port == port && s.secure == secure &&
+                !strncmp(s.host, host, sizeof(s.host)))
+            {
+                // Data left from the last response would be taken for the
+                // start of the next one
+                if (!s.conn->available() && s.sock.checkConnected())
+                {
+                    reuse = i;
+                    break;
+                }
+                _close(s);
+            }
+            // A closed slot, else the one idle the longest
+            if (fresh < 0 || (_slot[fresh].conn &&
+                              (!s.conn || now - s.idleSince > now - _slot[fresh].idleSince)))
+                fresh = i;
+        }
+
+        if (reuse >= 0)
+        {
+            _hits++;
+            _slot[reuse].busy = true;
+            return _slot[reuse].conn;
+        }
+        if (fresh < 0)
+            return NULL;
+
+        Slot& s = _slot[fresh];
+        _close(s);
+        _misses++;
+        Client* conn = &s.sock;
+        if (secure)
+            conn = _secure(fresh, s.sock, host, _secureCtx);
+        if (!conn)
+            return NULL;
+        bool ok = ip != IPAddress(0, 0, 0, 0) ? conn->connect(ip, port)
+                                               : conn->connect(host, port);
+        if (!ok)
+        {
+            conn->stop();
+            return NULL;
+        }
+        s.conn = conn;
+        s.secure = secure;
+        s.busy = true;
+        strncpy(s.host, host, sizeof(s.host) - 1);
+        s.host[sizeof(s.host) - 1] = '\0';
+        s.port = port;
+        return conn;
+    }
+
+    // Gives a connection back.  It stays open for the next request to the
+    // same server only if keepAlive is set and the last response was read
+    // to the end.
+    void release(Client* conn, bool keepAlive = true)
+    {
+        for (uint8_t i = 0; i < TINY_GSM_POOL_SLOTS; i++)
+        {
+            Slot& s = _slot[i];
+            if (!conn || s.conn != conn)
+                continue;
+            s.busy = false;
+            s.idleSince = millis();
+            if (!keepAlive || conn->available() || !conn->connected())
+                _close(s);
+            return;
+        }
+    }
+
+    // Closes connections that have been idle for at least idle_ms
+    void closeIdle(uint32_t idle_ms = 0)
+    {
+        for (uint8_t i = 0; i < TINY_GSM_POOL_SLOTS; i++)
+        {
+            Slot& s = _slot[i];
+            if (s.conn && !s.busy && millis() - s.idleSince >= idle_ms)
+                _close(s);
+        }
+    }
+
+    // Closes everything, including connections that are handed out
+    void closeAll()
+    {
+        for (uint8_t i = 0; i < TINY_GSM_POOL_SLOTS; i++)
+        {
+            _slot[i].busy = false;
+            _close(_slot[i]);
+        }
+    }
+
+    uint8_t idleCount() const
+    {
+        uint8_t n = 0;
+        for (uint8_t i = 0; i < TINY_GSM_POOL_SLOTS; i++)
+            n += _slot[i].conn && !_slot[i].busy;
+        return n;
+    }
+
+    // Requests served by an open connection, and those that had to open one
+    uint32_t hits() const
+    {
+        return _hits;
+    }
+
+    uint32_t misses() const
+    {
+        return _misses;
+    }
+
+private:
+    struct Slot
+    {
+        Socket   sock;
+        Client*  conn;       // sock, or what the factory put over it; NULL if closed
+        bool     secure;
+        bool     busy;
+        char     host[TINY_GSM_POOL_HOST];
+        uint16_t port;
+        uint32_t idleSince;
+    };
+
+    void _close(Slot& s)
+    {
+        if (s.conn)
+            s.conn->stop();
+        s.conn = NULL;
+        s.host[0] = '\0';
+    }
+
+    Slot          _slot[TINY_GSM_POOL_SLOTS];
+    SecureFactory _secure;
+    void*         _secureCtx;
+    uint32_t      _hits;
+    uint32_t      _misses;
+};
+
+#endif
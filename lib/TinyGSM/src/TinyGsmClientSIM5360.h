@@ -69,8 +69,9 @@ public:
     this->mux = mux;
     sock_available = 0;
     prev_check = 0;
+    poll_interval = TINY_GSM_POLL_MIN_MS;
+    polled = false;
     sock_connected = false;
-    got_data = false;
 
     at->sockets[mux] = this;
 
@@ -116,8 +117,9 @@ private:
   uint8_t         mux;
   uint16_t        sock_available;
   uint32_t        prev_check;
+  uint32_t        poll_interval;
   bool            sock_connected;
-  bool            got_data;
+  bool            polled;
   RxFifo          rx;
 };
 
@@ -490,7 +492,7 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     stream.readStringUntil('"');
     String hex = stream.readStringUntil('"');
     stream.readStringUntil(',');
-    int dcs = stream.readStringUntil('\n').toInt();
+    int dcs = streamReadInt('\n');
 
     if (dcs == 15) {
       return TinyGsmDecodeHex8bit(hex);
@@ -595,7 +597,7 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     }
     streamSkipUntil(','); // Skip battery charge status
     // Read battery charge level
-    int res = stream.readStringUntil(',').toInt();
+    int res = streamReadInt(',');
     // Wait for final OK
     waitResponse();
     return res;
@@ -607,7 +609,7 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
       return false;
     }
     // Read battery charge status
-    int res = stream.readStringUntil(',').toInt();
+    int res = streamReadInt(',');
     // Wait for final OK
     waitResponse();
     return res;
@@ -618,8 +620,8 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     if (waitResponse(GF(GSM_NL "+CBC:")) != 1) {
       return false;
     }
-    chargeState = stream.readStringUntil(',').toInt();
-    percent = stream.readStringUntil(',').toInt();
+    chargeState = streamReadInt(',');
+    percent = streamReadInt(',');
     // get voltage in VOLTS
     float voltage = stream.readStringUntil('\n').toFloat();
     milliVolts = voltage*1000;
@@ -680,6 +682,7 @@ protected:
       return 0;
     }
     stream.write((uint8_t*)buff, len);
+    TINY_GSM_AT_STATS_BYTES(len, 0)
     stream.flush();
     if (waitResponse(GF(GSM_NL "+CIPSEND:")) != 1) {
       return 0;
@@ -687,58 +690,20 @@ protected:
     streamSkipUntil(','); // Skip mux
     streamSkipUntil(','); // Skip requested bytes to send
     // TODO:  make sure requested and confirmed bytes match
-    return stream.readStringUntil('\n').toInt();
+    return streamReadInt('\n');
   }
 
-  size_t modemRead(size_t size, uint8_t mux) {
-#ifdef TINY_GSM_USE_HEX
-    sendAT(GF("+CIPRXGET=3,"), mux, ',', (uint16_t)size);
-    if (waitResponse(GF("+CIPRXGET:")) != 1) {
-      return 0;
-    }
-#else
-    sendAT(GF("+CIPRXGET=2,"), mux, ',', (uint16_t)size);
-    if (waitResponse(GF("+CIPRXGET:")) != 1) {
-      return 0;
-    }
-#endif
-    streamSkipUntil(','); // Skip Rx mode 2/normal or 3/HEX
-    streamSkipUntil(','); // Skip mux/cid (connecion id)
-    int len_requested = stream.readStringUntil(',').toInt();
-    //  ^^ Requested number of data bytes (1-1460 bytes)to be read
-    int len_confirmed = stream.readStringUntil('\n').toInt();
-    // ^^ The data length which not read in the buffer
-    for (int i=0; i<len_requested; i++) {
-      uint32_t startMillis = millis();
-#ifdef TINY_GSM_USE_HEX
-      while (stream.available() < 2 && (millis() - startMillis < sockets[mux]->_timeout)) { TINY_GSM_YIELD(); }
-      char buf[4] = { 0, };
-      buf[0] = stream.read();
-      buf[1] = stream.read();
-      char c = strtol(buf, NULL, 16);
-#else
-      while (!stream.available() && (millis() - startMillis < sockets[mux]->_timeout)) { TINY_GSM_YIELD(); }
-      char c = stream.read();
-#endif
-      sockets[mux]->rx.put(c);
-    }
-    DBG("### READ:", len_requested, "from", mux);
-    // sockets[mux]->sock_available = modemGetAvailable(mux);
-    sockets[mux]->sock_available = len_confirmed;
-    waitResponse();
-    return len_requested;
-  }
+TINY_GSM_MODEM_READ_CIPRXGET()
 
   size_t modemGetAvailable(uint8_t mux) {
     sendAT(GF("+CIPRXGET=4,"), mux);
     size_t result = 0;
-    if (waitResponse(GF("+CIPRXGET:")) == 1) {
-      streamSkipUntil(','); // Skip mode 4
+    if (waitResponse(GF("+CIPRXGET:")) == 1 && modemCipRxGetMode() == 4) {
       streamSkipUntil(','); // Skip mux
-      result = stream.readStringUntil('\n').toInt();
+      result = streamReadInt('\n');
       waitResponse();
     }
-    DBG("### Available:", result, "on", mux);
+    DBG_TRACE(GF("### Available:"), result, GF("on"), mux);
     if (!result) {
       sockets[mux]->sock_connected = modemGetConnected(mux);
     }
@@ -767,7 +732,26 @@ public:
 
 TINY_GSM_MODEM_STREAM_UTILITIES()
 
-  // TODO: Optimize this!
+TINY_GSM_MODEM_MATCHER()
+
+  // URCs handled by waitResponse(), matched alongside the expected responses
+  enum {
+    URC_CIPRXGET = TINY_GSM_MATCH_URC,
+    URC_RECEIVE,
+    URC_IPCLOSE,
+    URC_CIPEVENT
+  };
+
+  static GsmConstStr urcPattern(uint8_t id) {
+    switch (id) {
+      case URC_CIPRXGET: return GF(GSM_NL "+CIPRXGET:");
+      case URC_RECEIVE:  return GF(GSM_NL "+RECEIVE:");
+      case URC_IPCLOSE:  return GF("+IPCLOSE:");
+      case URC_CIPEVENT: return GF("+CIPEVENT:");
+      default: return NULL;
+    }
+  }
+
   uint8_t waitResponse(uint32_t timeout_ms, String& data,
                        GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
                        GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL)
@@ -779,6 +763,7 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
     String r5s(r5); r5s.trim();
     DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
     data.reserve(64);
+    matcherExpect(r1, r2, r3, r4, r5);
     int index = 0;
     unsigned long startMillis = millis();
     do {
@@ -787,52 +772,51 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
         TINY_GSM_YIELD();
         int a = stream.read();
         if (a <= 0) continue; // Skip 0x00 bytes, just in case
-        data += (char)a;
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
-          goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
-          goto finish;
-        } else if (r3 && data.endsWith(r3)) {
-          index = 3;
-          goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
+        TINY_GSM_LINE_PUT(data, a)
+        uint8_t hit = matcher.feed(a);
+        if (hit && hit < TINY_GSM_MATCH_URC) {
+          index = hit;
           goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
-          goto finish;
-        } else if (data.endsWith(GF(GSM_NL "+CIPRXGET:"))) {
-          String mode = stream.readStringUntil(',');
-          if (mode.toInt() == 1) {
-            int mux = stream.readStringUntil('\n').toInt();
+        } else if (hit >= match_app_base) {
+          urcDispatch(hit);
+          data = "";
+        } else if (hit == URC_CIPRXGET) {
+          int mode = streamReadInt(',');
+          if (mode == 1) {
+            int mux = streamReadInt('\n');
             if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-              sockets[mux]->got_data = true;
+              sock_pending |= TINY_GSM_SOCK_BIT(mux);
             }
             data = "";
-            DBG("### Got Data:", mux);
+            DBG_TRACE(GF("### Got Data:"), mux);
+#if defined(TINY_GSM_READ_AHEAD)
+          } else if (read_ahead_mux >= 0) {
+            // Reply to the client's read-ahead request
+            modemReadPayload();
+            data = "";
+            goto finish;
+#endif
           } else {
             data += mode;
           }
-        } else if (data.endsWith(GF(GSM_NL "+RECEIVE:"))) {
-          int mux = stream.readStringUntil(',').toInt();
-          int len = stream.readStringUntil('\n').toInt();
+        } else if (hit == URC_RECEIVE) {
+          int mux = streamReadInt(',');
+          int len = streamReadInt('\n');
           if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-            sockets[mux]->got_data = true;
+            sock_pending |= TINY_GSM_SOCK_BIT(mux);
             sockets[mux]->sock_available = len;
           }
           data = "";
-          DBG("### Got Data:", len, "on", mux);
-        } else if (data.endsWith(GF("+IPCLOSE:"))) {
-          int mux = stream.readStringUntil(',').toInt();
+          DBG_TRACE(GF("### Got Data:"), len, GF("on"), mux);
+        } else if (hit == URC_IPCLOSE) {
+          int mux = streamReadInt(',');
           streamSkipUntil('\n');  // Skip the reason code
           if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
             sockets[mux]->sock_connected = false;
           }
           data = "";
           DBG("### Closed: ", mux);
-        } else if (data.endsWith(GF("+CIPEVENT:"))) {
+        } else if (hit == URC_CIPEVENT) {
           // Need to close all open sockets and release the network library.
           // User will then need to reconnect.
           DBG("### Network error!");
@@ -842,9 +826,13 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
           data = "";
         }
       }
+      if (TINY_GSM_URC_DRAIN_IDLE()) {
+        break;
+      }
     } while (millis() - startMillis < timeout_ms);
 finish:
-    if (!index) {
+    TINY_GSM_AT_STATS_RESULT(index)
+    if (!index && !match_resume) {
       data.trim();
       if (data.length()) {
         DBG("### Unhandled:", data);
@@ -860,8 +848,8 @@ finish:
                        GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
                        GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL)
   {
-    String data;
-    return waitResponse(timeout_ms, data, r1, r2, r3, r4, r5);
+    wait_line = "";
+    return waitResponse(timeout_ms, wait_line, r1, r2, r3, r4, r5);
   }
 
   uint8_t waitResponse(GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
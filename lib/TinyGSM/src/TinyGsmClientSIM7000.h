@@ -69,8 +69,9 @@ public:
     this->mux = mux;
     sock_available = 0;
     prev_check = 0;
+    poll_interval = TINY_GSM_POLL_MIN_MS;
+    polled = false;
     sock_connected = false;
-    got_data = false;
 
     at->sockets[mux] = this;
 
@@ -116,8 +117,9 @@ private:
   uint8_t         mux;
   uint16_t        sock_available;
   uint32_t        prev_check;
+  uint32_t        poll_interval;
   bool            sock_connected;
-  bool            got_data;
+  bool            polled;
   RxFifo          rx;
 };
 
@@ -369,6 +371,51 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     return res;
   }
 
+  // Current CNMP setting (2 automatic, 13 GSM, 38 LTE, 51 GSM and LTE),
+  // -1 if unknown
+  int16_t getNetworkMode() {
+    sendAT(GF("+CNMP?"));
+    if (waitResponse(GF(GSM_NL "+CNMP:")) != 1) {
+      return -1;
+    }
+    int16_t mode = streamReadInt('\n');
+    waitResponse();
+    return mode;
+  }
+
+  // Current CMNB setting (1 CAT-M, 2 NB-IoT, 3 both), -1 if unknown
+  int16_t getPreferredMode() {
+    sendAT(GF("+CMNB?"));
+    if (waitResponse(GF(GSM_NL "+CMNB:")) != 1) {
+      return -1;
+    }
+    int16_t mode = streamReadInt('\n');
+    waitResponse();
+    return mode;
+  }
+
+  // Bands enabled for "CAT-M" or "NB-IOT", as a list like "3,8,20"
+  String getBands(const char* rat) {
+    sendAT(GF("+CBANDCFG?"));
+    String res;
+    while (waitResponse(1000L, GF(GSM_NL "+CBANDCFG: \""), GFP(GSM_OK), GFP(GSM_ERROR)) == 1) {
+      String name = stream.readStringUntil('"');
+      streamSkipUntil(',');
+      String bands = stream.readStringUntil('\n');
+      if (name == rat) {
+        bands.trim();
+        res = bands;
+      }
+    }
+    return res;
+  }
+
+  // Limits the bands searched for "CAT-M" or "NB-IOT", e.g. to "3,8,20"
+  bool setBands(const char* rat, const char* bands) {
+    sendAT(GF("+CBANDCFG=\""), rat, GF("\","), bands);
+    return waitResponse() == 1;
+  }
+
 
   /*
    * GPRS functions
@@ -473,7 +520,7 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     if (waitResponse(GF(GSM_NL "+CGATT:")) != 1) {
       return false;
     }
-    int res = stream.readStringUntil('\n').toInt();
+    int res = streamReadInt('\n');
     waitResponse();
     if (res != 1)
       return false;
@@ -505,6 +552,8 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     return TinyGsmIpFromString(getLocalIP());
   }
 
+TINY_GSM_MODEM_DNS_CDNSGIP()
+
   /*
    * Phone Call functions
    */
@@ -534,7 +583,7 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     stream.readStringUntil('"');
     String hex = stream.readStringUntil('"');
     stream.readStringUntil(',');
-    int dcs = stream.readStringUntil('\n').toInt();
+    int dcs = streamReadInt('\n');
 
     if (dcs == 15) {
       return TinyGsmDecodeHex8bit(hex);
@@ -652,7 +701,7 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     }
 
     stream.readStringUntil(','); // mode
-    if ( stream.readStringUntil(',').toInt() == 1 ) fix = true;
+    if ( streamReadInt(',') == 1 ) fix = true;
     stream.readStringUntil(','); //utctime
     *lat =  stream.readStringUntil(',').toFloat(); //lat
     *lon =  stream.readStringUntil(',').toFloat(); //lon
@@ -665,8 +714,8 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     stream.readStringUntil(',');
     stream.readStringUntil(',');
     stream.readStringUntil(',');
-    if (vsat != NULL) *vsat = stream.readStringUntil(',').toInt(); //viewed satelites
-    if (usat != NULL) *usat = stream.readStringUntil(',').toInt(); //used satelites
+    if (vsat != NULL) *vsat = streamReadInt(','); //viewed satelites
+    if (usat != NULL) *usat = streamReadInt(','); //used satelites
     stream.readStringUntil('\n');
 
     waitResponse();
@@ -678,6 +727,27 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
    * Time functions
    */
 
+  // Lets the network set the clock when the modem registers, so CCLK reads
+  // real time instead of its power-on default.  The setting is saved, so
+  // this only writes it once.
+  bool enableNetworkTime() {
+    sendAT(GF("+CLTS?"));
+    if (waitResponse(GF(GSM_NL "+CLTS:")) != 1) {
+      return false;
+    }
+    int on = streamReadInt('\n');
+    waitResponse();
+    if (on == 1) {
+      return true;
+    }
+    sendAT(GF("+CLTS=1"));
+    if (waitResponse(2000L) != 1) {
+      return false;
+    }
+    sendAT(GF("&W"));
+    return waitResponse() == 1;
+  }
+
   String getGSMDateTime(TinyGSMDateTimeFormat format) {
     sendAT(GF("+CCLK?"));
     if (waitResponse(2000L, GF(GSM_NL "+CCLK: \"")) != 1) {
@@ -761,7 +831,7 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     streamSkipUntil(','); // Skip battery charge status
     streamSkipUntil(','); // Skip battery charge level
     // return voltage in mV
-    uint16_t res = stream.readStringUntil(',').toInt();
+    uint16_t res = streamReadInt(',');
     // Wait for final OK
     waitResponse();
     return res;
@@ -774,7 +844,7 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     }
     streamSkipUntil(','); // Skip battery charge status
     // Read battery charge level
-    int res = stream.readStringUntil(',').toInt();
+    int res = streamReadInt(',');
     // Wait for final OK
     waitResponse();
     return res;
@@ -786,7 +856,7 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
       return false;
     }
     // Read battery charge status
-    int res = stream.readStringUntil(',').toInt();
+    int res = streamReadInt(',');
     // Wait for final OK
     waitResponse();
     return res;
@@ -797,9 +867,9 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     if (waitResponse(GF(GSM_NL "+CBC:")) != 1) {
       return false;
     }
-    chargeState = stream.readStringUntil(',').toInt();
-    percent = stream.readStringUntil(',').toInt();
-    milliVolts = stream.readStringUntil('\n').toInt();
+    chargeState = streamReadInt(',');
+    percent = streamReadInt(',');
+    milliVolts = streamReadInt('\n');
     // Wait for final OK
     waitResponse();
     return true;
@@ -837,65 +907,26 @@ protected:
       return 0;
     }
     stream.write((uint8_t*)buff, len);
+    TINY_GSM_AT_STATS_BYTES(len, 0)
     stream.flush();
     if (waitResponse(GF(GSM_NL "DATA ACCEPT:")) != 1) {
       return 0;
     }
     streamSkipUntil(','); // Skip mux
-    return stream.readStringUntil('\n').toInt();
+    return streamReadInt('\n');
   }
 
-  size_t modemRead(size_t size, uint8_t mux) {
-#ifdef TINY_GSM_USE_HEX
-    sendAT(GF("+CIPRXGET=3,"), mux, ',', (uint16_t)size);
-    if (waitResponse(GF("+CIPRXGET:")) != 1) {
-      return 0;
-    }
-#else
-    sendAT(GF("+CIPRXGET=2,"), mux, ',', (uint16_t)size);
-    if (waitResponse(GF("+CIPRXGET:")) != 1) {
-      return 0;
-    }
-#endif
-    streamSkipUntil(','); // Skip Rx mode 2/normal or 3/HEX
-    streamSkipUntil(','); // Skip mux
-    int len_requested = stream.readStringUntil(',').toInt();
-    //  ^^ Requested number of data bytes (1-1460 bytes)to be read
-    int len_confirmed = stream.readStringUntil('\n').toInt();
-    // ^^ Confirmed number of data bytes to be read, which may be less than requested.
-    // 0 indicates that no data can be read.
-    // This is actually be the number of bytes that will be remaining after the read
-    for (int i=0; i<len_requested; i++) {
-      uint32_t startMillis = millis();
-#ifdef TINY_GSM_USE_HEX
-      while (stream.available() < 2 && (millis() - startMillis < sockets[mux]->_timeout)) { TINY_GSM_YIELD(); }
-      char buf[4] = { 0, };
-      buf[0] = stream.read();
-      buf[1] = stream.read();
-      char c = strtol(buf, NULL, 16);
-#else
-      while (!stream.available() && (millis() - startMillis < sockets[mux]->_timeout)) { TINY_GSM_YIELD(); }
-      char c = stream.read();
-#endif
-      sockets[mux]->rx.put(c);
-    }
-    DBG("### READ:", len_requested, "from", mux);
-    // sockets[mux]->sock_available = modemGetAvailable(mux);
-    sockets[mux]->sock_available = len_confirmed;
-    waitResponse();
-    return len_requested;
-  }
+TINY_GSM_MODEM_READ_CIPRXGET()
 
   size_t modemGetAvailable(uint8_t mux) {
     sendAT(GF("+CIPRXGET=4,"), mux);
     size_t result = 0;
-    if (waitResponse(GF("+CIPRXGET:")) == 1) {
-      streamSkipUntil(','); // Skip mode 4
+    if (waitResponse(GF("+CIPRXGET:")) == 1 && modemCipRxGetMode() == 4) {
       streamSkipUntil(','); // Skip mux
-      result = stream.readStringUntil('\n').toInt();
+      result = streamReadInt('\n');
       waitResponse();
     }
-    DBG("### Available:", result, "on", mux);
+    DBG_TRACE(GF("### Available:"), result, GF("on"), mux);
     if (!result) {
       sockets[mux]->sock_connected = modemGetConnected(mux);
     }
@@ -917,7 +948,24 @@ public:
 
 TINY_GSM_MODEM_STREAM_UTILITIES()
 
-  // TODO: Optimize this!
+TINY_GSM_MODEM_MATCHER()
+
+  // URCs handled by waitResponse(), matched alongside the expected responses
+  enum {
+    URC_CIPRXGET = TINY_GSM_MATCH_URC,
+    URC_RECEIVE,
+    URC_CLOSED
+  };
+
+  static GsmConstStr urcPattern(uint8_t id) {
+    switch (id) {
+      case URC_CIPRXGET: return GF(GSM_NL "+CIPRXGET:");
+      case URC_RECEIVE:  return GF(GSM_NL "+RECEIVE:");
+      case URC_CLOSED:   return GF("CLOSED" GSM_NL);
+      default: return NULL;
+    }
+  }
+
   uint8_t waitResponse(uint32_t timeout_ms, String& data,
                        GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
                        GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL)
@@ -929,6 +977,7 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
     String r5s(r5); r5s.trim();
     DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
     data.reserve(64);
+    matcherExpect(r1, r2, r3, r4, r5);
     int index = 0;
     unsigned long startMillis = millis();
     do {
@@ -937,47 +986,44 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
         TINY_GSM_YIELD();
         int a = stream.read();
         if (a <= 0) continue; // Skip 0x00 bytes, just in case
-        data += (char)a;
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
-          goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
-          goto finish;
-        } else if (r3 && data.endsWith(r3)) {
-          index = 3;
+        TINY_GSM_LINE_PUT(data, a)
+        uint8_t hit = matcher.feed(a);
+        if (hit && hit < TINY_GSM_MATCH_URC) {
+          index = hit;
           goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
-          goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
-          goto finish;
-        } else if (data.endsWith(GF(GSM_NL "+CIPRXGET:"))) {
-          String mode = stream.readStringUntil(',');
-          if (mode.toInt() == 1) {
-            int mux = stream.readStringUntil('\n').toInt();
+        } else if (hit >= match_app_base) {
+          urcDispatch(hit);
+          data = "";
+        } else if (hit == URC_CIPRXGET) {
+          int mode = streamReadInt(',');
+          if (mode == 1) {
+            int mux = streamReadInt('\n');
             if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-              sockets[mux]->got_data = true;
+              sock_pending |= TINY_GSM_SOCK_BIT(mux);
             }
             data = "";
-            DBG("### Got Data:", mux);
+            DBG_TRACE(GF("### Got Data:"), mux);
+#if defined(TINY_GSM_READ_AHEAD)
+          } else if (read_ahead_mux >= 0) {
+            // Reply to the client's read-ahead request
+            modemReadPayload();
+            data = "";
+            goto finish;
+#endif
           } else {
             data += mode;
           }
-        } else if (data.endsWith(GF(GSM_NL "+RECEIVE:"))) {
-          int mux = stream.readStringUntil(',').toInt();
-          int len = stream.readStringUntil('\n').toInt();
+        } else if (hit == URC_RECEIVE) {
+          int mux = streamReadInt(',');
+          int len = streamReadInt('\n');
           if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-            sockets[mux]->got_data = true;
+            sock_pending |= TINY_GSM_SOCK_BIT(mux);
             sockets[mux]->sock_available = len;
           }
           data = "";
-          DBG("### Got Data:", len, "on", mux);
-        } else if (data.endsWith(GF("CLOSED" GSM_NL))) {
-          int nl = data.lastIndexOf(GSM_NL, data.length()-8);
-          int coma = data.indexOf(',', nl+2);
-          int mux = data.substring(nl+2, coma).toInt();
+          DBG_TRACE(GF("### Got Data:"), len, GF("on"), mux);
+        } else if (hit == URC_CLOSED) {
+          int mux = TinyGsmUrcMux(data, 8);
           if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
             sockets[mux]->sock_connected = false;
           }
@@ -985,9 +1031,13 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
           DBG("### Closed: ", mux);
         }
       }
+      if (TINY_GSM_URC_DRAIN_IDLE()) {
+        break;
+      }
     } while (millis() - startMillis < timeout_ms);
 finish:
-    if (!index) {
+    TINY_GSM_AT_STATS_RESULT(index)
+    if (!index && !match_resume) {
       data.trim();
       if (data.length()) {
         DBG("### Unhandled:", data);
@@ -1003,8 +1053,8 @@ finish:
                        GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
                        GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL)
   {
-    String data;
-    return waitResponse(timeout_ms, data, r1, r2, r3, r4, r5);
+    wait_line = "";
+    return waitResponse(timeout_ms, wait_line, r1, r2, r3, r4, r5);
   }
 
   uint8_t waitResponse(GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
@@ -69,8 +69,9 @@ public:
     this->mux = mux;
     sock_available = 0;
     prev_check = 0;
+    poll_interval = TINY_GSM_POLL_MIN_MS;
+    polled = false;
     sock_connected = false;
-    got_data = false;
 
     at->sockets[mux] = this;
 
@@ -116,12 +117,24 @@ private:
   uint8_t         mux;
   uint16_t        sock_available;
   uint32_t        prev_check;
+  uint32_t        poll_interval;
   bool            sock_connected;
-  bool            got_data;
+  bool            polled;
   RxFifo          rx;
 };
 
 
+/*
+ * Single socket in transparent mode (AT+CIPMODE=1): once connected, payload
+ * bytes go over the UART with no CIPRXGET/CIPSEND round trips.
+ * The socket service has to be restarted to change mode, so the regular
+ * clients are closed on connect() and command mode is restored on stop().
+ * No other modem functions may be used while a transparent connection is
+ * open.
+ */
+TINY_GSM_CLIENT_TRANSPARENT(TinyGsmSim7600, "CLOSED")
+
+
 public:
 
   TinyGsmSim7600(Stream& stream)
@@ -341,11 +354,20 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     sendAT(GF("+CGDCONT=1,\"IP\",\""), apn, '"',",\"0.0.0.0\",0,0");
     waitResponse();
 
+    return gprsStartIP();
+  }
+
+  // Configures and starts the socket service, either for multiple sockets
+  // in command mode or, with transparent set, for a single socket in
+  // transparent mode.  CIPMODE can only be changed while NETOPEN is down.
+  bool gprsStartIP(bool transparent = false) {
     // Configure TCP parameters
 
-    // Select TCP/IP application mode (command mode)
-    sendAT(GF("+CIPMODE=0"));
-    waitResponse();
+    // Select TCP/IP application mode (command or transparent mode)
+    sendAT(GF("+CIPMODE="), transparent ? 1 : 0);
+    if (waitResponse() != 1 && transparent) {
+      return false;
+    }
 
     // Set Sending Mode - send without waiting for peer TCP ACK
     sendAT(GF("+CIPSENDMODE=0"));
@@ -466,7 +488,7 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     stream.readStringUntil('"');
     String hex = stream.readStringUntil('"');
     stream.readStringUntil(',');
-    int dcs = stream.readStringUntil('\n').toInt();
+    int dcs = streamReadInt('\n');
 
     if (dcs == 15) {
       return TinyGsmDecodeHex8bit(hex);
@@ -578,7 +600,7 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     }
 
     //stream.readStringUntil(','); // mode
-    if ( stream.readStringUntil(',').toInt() == 1 ) fix = true;
+    if ( streamReadInt(',') == 1 ) fix = true;
     stream.readStringUntil(','); //gps
     stream.readStringUntil(','); // glonass
     stream.readStringUntil(','); // beidu
@@ -644,7 +666,7 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
       return 0;
     }
     // return temperature in C
-    uint16_t res = stream.readStringUntil('\n').toInt();
+    uint16_t res = streamReadInt('\n');
     // Wait for final OK
     waitResponse();
     return res;
@@ -678,12 +700,66 @@ protected:
    return true;
   }
 
+  // Transparent mode only supports link 0, so mux is unused here
+  bool modemTransparentConnect(const char* host, uint16_t port, uint8_t,
+                               int timeout_s = 15) {
+    uint32_t timeout_ms = ((uint32_t)timeout_s) * 1000;
+    if (!modemTransparentRestart(true)) {
+      modemTransparentRestart(false);
+      return false;
+    }
+    sendAT(GF("+CIPOPEN=0,\"TCP\",\""), host, GF("\","), port);
+    // In transparent mode the reply is CONNECT [<rate>] or CONNECT FAIL
+    int rsp = waitResponse(timeout_ms,
+                           GF(GSM_NL "CONNECT" GSM_NL),
+                           GF(GSM_NL "CONNECT "),
+                           GFP(GSM_ERROR));
+    if (rsp == 2) {
+      String rate = stream.readStringUntil('\n');
+      if (rate.startsWith("FAIL")) {
+        rsp = 0;
+      }
+    }
+    if (rsp != 1 && rsp != 2) {
+      modemTransparentRestart(false);
+      return false;
+    }
+    return true;
+  }
+
+  void modemTransparentClose(uint8_t, bool data_mode) {
+    if (data_mode) {
+      // Escape sequence needs a second of silence before and half after
+      delay(1000);
+      stream.print(GF("+++"));
+      stream.flush();
+      delay(500);
+      waitResponse();
+    }
+    sendAT(GF("+CIPCLOSE=0"));
+    waitResponse();
+    modemTransparentRestart(false);
+  }
+
+  // Stops the socket service and starts it again in the requested mode
+  bool modemTransparentRestart(bool transparent) {
+    sendAT(GF("+NETCLOSE"));
+    waitResponse(60000L, GF(GSM_NL "+NETCLOSE:"));
+    for (int mux = 0; mux < TINY_GSM_MUX_COUNT; mux++) {
+      if (sockets[mux]) {
+        sockets[mux]->sock_connected = false;
+      }
+    }
+    return gprsStartIP(transparent);
+  }
+
   int16_t modemSend(const void* buff, size_t len, uint8_t mux) {
     sendAT(GF("+CIPSEND="), mux, ',', (uint16_t)len);
     if (waitResponse(GF(">")) != 1) {
       return 0;
     }
     stream.write((uint8_t*)buff, len);
+    TINY_GSM_AT_STATS_BYTES(len, 0)
     stream.flush();
     if (waitResponse(GF(GSM_NL "+CIPSEND:")) != 1) {
       return 0;
@@ -691,58 +767,20 @@ protected:
     streamSkipUntil(','); // Skip mux
     streamSkipUntil(','); // Skip requested bytes to send
     // TODO:  make sure requested and confirmed bytes match
-    return stream.readStringUntil('\n').toInt();
+    return streamReadInt('\n');
   }
 
-  size_t modemRead(size_t size, uint8_t mux) {
-#ifdef TINY_GSM_USE_HEX
-    sendAT(GF("+CIPRXGET=3,"), mux, ',', (uint16_t)size);
-    if (waitResponse(GF("+CIPRXGET:")) != 1) {
-      return 0;
-    }
-#else
-    sendAT(GF("+CIPRXGET=2,"), mux, ',', (uint16_t)size);
-    if (waitResponse(GF("+CIPRXGET:")) != 1) {
-      return 0;
-    }
-#endif
-    streamSkipUntil(','); // Skip Rx mode 2/normal or 3/HEX
-    streamSkipUntil(','); // Skip mux/cid (connecion id)
-    int len_requested = stream.readStringUntil(',').toInt();
-    //  ^^ Requested number of data bytes (1-1460 bytes)to be read
-    int len_confirmed = stream.readStringUntil('\n').toInt();
-    // ^^ The data length which not read in the buffer
-    for (int i=0; i<len_requested; i++) {
-      uint32_t startMillis = millis();
-#ifdef TINY_GSM_USE_HEX
-      while (stream.available() < 2 && (millis() - startMillis < sockets[mux]->_timeout)) { TINY_GSM_YIELD(); }
-      char buf[4] = { 0, };
-      buf[0] = stream.read();
-      buf[1] = stream.read();
-      char c = strtol(buf, NULL, 16);
-#else
-      while (!stream.available() && (millis() - startMillis < sockets[mux]->_timeout)) { TINY_GSM_YIELD(); }
-      char c = stream.read();
-#endif
-      sockets[mux]->rx.put(c);
-    }
-    DBG("### READ:", len_requested, "from", mux);
-    // sockets[mux]->sock_available = modemGetAvailable(mux);
-    sockets[mux]->sock_available = len_confirmed;
-    waitResponse();
-    return len_requested;
-  }
+TINY_GSM_MODEM_READ_CIPRXGET()
 
   size_t modemGetAvailable(uint8_t mux) {
     sendAT(GF("+CIPRXGET=4,"), mux);
     size_t result = 0;
-    if (waitResponse(GF("+CIPRXGET:")) == 1) {
-      streamSkipUntil(','); // Skip mode 4
+    if (waitResponse(GF("+CIPRXGET:")) == 1 && modemCipRxGetMode() == 4) {
       streamSkipUntil(','); // Skip mux
-      result = stream.readStringUntil('\n').toInt();
+      result = streamReadInt('\n');
       waitResponse();
     }
-    DBG("### Available:", result, "on", mux);
+    DBG_TRACE(GF("### Available:"), result, GF("on"), mux);
     if (!result) {
       sockets[mux]->sock_connected = modemGetConnected(mux);
     }
@@ -771,7 +809,26 @@ public:
 
 TINY_GSM_MODEM_STREAM_UTILITIES()
 
-  // TODO: Optimize this!
+TINY_GSM_MODEM_MATCHER()
+
+  // URCs handled by waitResponse(), matched alongside the expected responses
+  enum {
+    URC_CIPRXGET = TINY_GSM_MATCH_URC,
+    URC_RECEIVE,
+    URC_IPCLOSE,
+    URC_CIPEVENT
+  };
+
+  static GsmConstStr urcPattern(uint8_t id) {
+    switch (id) {
+      case URC_CIPRXGET: return GF(GSM_NL "+CIPRXGET:");
+      case URC_RECEIVE:  return GF(GSM_NL "+RECEIVE:");
+      case URC_IPCLOSE:  return GF("+IPCLOSE:");
+      case URC_CIPEVENT: return GF("+CIPEVENT:");
+      default: return NULL;
+    }
+  }
+
   uint8_t waitResponse(uint32_t timeout_ms, String& data,
                        GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
                        GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL)
@@ -783,6 +840,7 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
     String r5s(r5); r5s.trim();
     DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
     data.reserve(64);
+    matcherExpect(r1, r2, r3, r4, r5);
     int index = 0;
     unsigned long startMillis = millis();
     do {
@@ -791,52 +849,51 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
         TINY_GSM_YIELD();
         int a = stream.read();
         if (a <= 0) continue; // Skip 0x00 bytes, just in case
-        data += (char)a;
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
-          goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
-          goto finish;
-        } else if (r3 && data.endsWith(r3)) {
-          index = 3;
+        TINY_GSM_LINE_PUT(data, a)
+        uint8_t hit = matcher.feed(a);
+        if (hit && hit < TINY_GSM_MATCH_URC) {
+          index = hit;
           goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
-          goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
-          goto finish;
-        } else if (data.endsWith(GF(GSM_NL "+CIPRXGET:"))) {
-          String mode = stream.readStringUntil(',');
-          if (mode.toInt() == 1) {
-            int mux = stream.readStringUntil('\n').toInt();
+        } else if (hit >= match_app_base) {
+          urcDispatch(hit);
+          data = "";
+        } else if (hit == URC_CIPRXGET) {
+          int mode = streamReadInt(',');
+          if (mode == 1) {
+            int mux = streamReadInt('\n');
             if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-              sockets[mux]->got_data = true;
+              sock_pending |= TINY_GSM_SOCK_BIT(mux);
             }
             data = "";
-            DBG("### Got Data:", mux);
+            DBG_TRACE(GF("### Got Data:"), mux);
+#if defined(TINY_GSM_READ_AHEAD)
+          } else if (read_ahead_mux >= 0) {
+            // Reply to the client's read-ahead request
+            modemReadPayload();
+            data = "";
+            goto finish;
+#endif
           } else {
             data += mode;
           }
-        } else if (data.endsWith(GF(GSM_NL "+RECEIVE:"))) {
-          int mux = stream.readStringUntil(',').toInt();
-          int len = stream.readStringUntil('\n').toInt();
+        } else if (hit == URC_RECEIVE) {
+          int mux = streamReadInt(',');
+          int len = streamReadInt('\n');
           if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-            sockets[mux]->got_data = true;
+            sock_pending |= TINY_GSM_SOCK_BIT(mux);
             sockets[mux]->sock_available = len;
           }
           data = "";
-          DBG("### Got Data:", len, "on", mux);
-        } else if (data.endsWith(GF("+IPCLOSE:"))) {
-          int mux = stream.readStringUntil(',').toInt();
+          DBG_TRACE(GF("### Got Data:"), len, GF("on"), mux);
+        } else if (hit == URC_IPCLOSE) {
+          int mux = streamReadInt(',');
           streamSkipUntil('\n');  // Skip the reason code
           if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
             sockets[mux]->sock_connected = false;
           }
           data = "";
           DBG("### Closed: ", mux);
-        } else if (data.endsWith(GF("+CIPEVENT:"))) {
+        } else if (hit == URC_CIPEVENT) {
           // Need to close all open sockets and release the network library.
           // User will then need to reconnect.
           DBG("### Network error!");
@@ -846,9 +903,13 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
           data = "";
         }
       }
+      if (TINY_GSM_URC_DRAIN_IDLE()) {
+        break;
+      }
     } while (millis() - startMillis < timeout_ms);
 finish:
-    if (!index) {
+    TINY_GSM_AT_STATS_RESULT(index)
+    if (!index && !match_resume) {
       data.trim();
       if (data.length()) {
         DBG("### Unhandled:", data);
@@ -864,8 +925,8 @@ finish:
                        GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
                        GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL)
   {
-    String data;
-    return waitResponse(timeout_ms, data, r1, r2, r3, r4, r5);
+    wait_line = "";
+    return waitResponse(timeout_ms, wait_line, r1, r2, r3, r4, r5);
   }
 
   uint8_t waitResponse(GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
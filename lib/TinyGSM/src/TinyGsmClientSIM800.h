@@ -70,8 +70,9 @@ public:
     this->mux = mux;
     sock_available = 0;
     prev_check = 0;
+    poll_interval = TINY_GSM_POLL_MIN_MS;
+    polled = false;
     sock_connected = false;
-    got_data = false;
 
     at->sockets[mux] = this;
 
@@ -117,8 +118,9 @@ private:
   uint8_t         mux;
   uint16_t        sock_available;
   uint32_t        prev_check;
+  uint32_t        poll_interval;
   bool            sock_connected;
-  bool            got_data;
+  bool            polled;
   RxFifo          rx;
 };
 
@@ -145,12 +147,26 @@ public:
 };
 
 
+/*
+ * Single socket in transparent mode (AT+CIPMODE=1): once connected, payload
+ * bytes go over the UART with no AT framing at all, which makes it the
+ * fastest way to pull a large download such as a firmware image.
+ * The modem has to be switched to single-connection mode for this, so the
+ * regular multi-socket clients are closed on connect() and the multi-socket
+ * setup is restored on stop().  No other modem functions may be used while
+ * a transparent connection is open.
+ */
+TINY_GSM_CLIENT_TRANSPARENT(TinyGsmSim800, "CLOSED")
+
+
 public:
 
   TinyGsmSim800(Stream& stream)
     : stream(stream)
   {
     memset(sockets, 0, sizeof(sockets));
+    sends_pending = 0;
+    memset(sends_mux, 0, sizeof(sends_mux));
   }
 
   virtual ~TinyGsmSim800() {}
@@ -237,6 +253,13 @@ TINY_GSM_MODEM_MAINTAIN_CHECK_SOCKS()
     return waitResponse() == 1;
   }
 
+  // RTS/CTS on the modem's UART, so it holds data back while the board is
+  // busy.  The board's side has to be switched on to match.
+  bool setFlowControl(bool hardware) {
+    sendAT(hardware ? GF("+IFC=2,2") : GF("+IFC=0,0"));
+    return waitResponse() == 1;
+  }
+
 TINY_GSM_MODEM_GET_INFO_ATI()
 
   bool hasSSL() {
@@ -357,6 +380,29 @@ TINY_GSM_MODEM_GET_CSQ()
 
 TINY_GSM_MODEM_WAIT_FOR_NETWORK()
 
+  // Bands searched, as CBAND names them, e.g. "EGSM_DCS_MODE" or
+  // "ALL_BAND"; empty if unknown
+  String getBand() {
+    sendAT(GF("+CBAND?"));
+    if (waitResponse(GF(GSM_NL "+CBAND:")) != 1) {
+      return "";
+    }
+    String res = stream.readStringUntil('\n');
+    waitResponse();
+    int comma = res.indexOf(',');
+    if (comma >= 0) {
+      res.remove(comma);  // Drop the list of supported bands
+    }
+    res.replace("\"", "");
+    res.trim();
+    return res;
+  }
+
+  bool setBand(const char* band) {
+    sendAT(GF("+CBAND=\""), band, '"');
+    return waitResponse() == 1;
+  }
+
   /*
    * GPRS functions
    */
@@ -403,34 +449,65 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
 
     // TODO: wait AT+CGATT?
 
-    // Set to multi-IP
-    sendAT(GF("+CIPMUX=1"));
-    if (waitResponse() != 1) {
-      return false;
-    }
+    gprs_apn = apn;
+    gprs_user = user ? user : "";
+    gprs_pwd = pwd ? pwd : "";
+    return gprsStartIP();
+  }
 
-    // Put in "quick send" mode (thus no extra "Send OK")
-    sendAT(GF("+CIPQSEND=1"));
-    if (waitResponse() != 1) {
-      return false;
-    }
+  // Sets up the TCP/IP application layer on an attached bearer, either for
+  // multiple sockets with manual data retrieval or, with transparent set,
+  // for a single socket in transparent mode
+  bool gprsStartIP(bool transparent = false) {
+    if (transparent) {
+      // Set to single-IP in transparent mode
+      sendAT(GF("+CIPMUX=0"));
+      if (waitResponse() != 1) {
+        return false;
+      }
+      sendAT(GF("+CIPMODE=1"));
+      if (waitResponse() != 1) {
+        return false;
+      }
+    } else {
+      // Set to multi-IP
+      sendAT(GF("+CIPMUX=1"));
+      if (waitResponse() != 1) {
+        return false;
+      }
 
-    // Set to get data manually
-    sendAT(GF("+CIPRXGET=1"));
-    if (waitResponse() != 1) {
-      return false;
+      // Put in "quick send" mode (thus no extra "Send OK")
+      sendAT(GF("+CIPQSEND=1"));
+      if (waitResponse() != 1) {
+        return false;
+      }
+
+      // Set to get data manually
+      sendAT(GF("+CIPRXGET=1"));
+      if (waitResponse() != 1) {
+        return false;
+      }
     }
 
     // Start Task and Set APN, USER NAME, PASSWORD
-    sendAT(GF("+CSTT=\""), apn, GF("\",\""), user, GF("\",\""), pwd, GF("\""));
+    sendAT(GF("+CSTT=\""), gprs_apn, GF("\",\""), gprs_user, GF("\",\""), gprs_pwd, GF("\""));
     if (waitResponse(2000L) != 1) {
       return false;
     }
 
-    // Bring Up Wireless Connection with GPRS or CSD
-    sendAT(GF("+CIICR"));
-    if (waitResponse(2000L) != 1) {
-      return false;
+    return gprsBringUp();
+  }
+
+  // Finishes bringing up the IP connection once the task has been started.
+  // If the wireless connection is already active, only the local IP and
+  // DNS are set.
+  bool gprsBringUp(bool activate = true) {
+    if (activate) {
+      // Bring Up Wireless Connection with GPRS or CSD
+      sendAT(GF("+CIICR"));
+      if (waitResponse(2000L) != 1) {
+        return false;
+      }
     }
 
     // Get Local IP Address, only assigned after connection
@@ -448,6 +525,65 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     return true;
   }
 
+  // Picks up a connection that is still (partly) up, e.g. when the ESP
+  // restarted but the modem didn't, and runs only the steps still missing.
+  // Falls back to the full gprsConnect() if there is nothing to pick up.
+  bool gprsResume(const char* apn, const char* user = NULL, const char* pwd = NULL) {
+    gprs_apn = apn;
+    gprs_user = user ? user : "";
+    gprs_pwd = pwd ? pwd : "";
+
+    char state[16];
+    sendAT(GF("+CIPSTATUS"));
+    if (waitResponse() == 1 && waitResponse(2000L, GF(GSM_NL "STATE: ")) == 1) {
+      streamReadToken(state, sizeof(state), '\n');
+      // Multi-IP follows up with a "C:" line per connection, 0 to 5, which
+      // would otherwise end up in the next command's response
+      for (int n = 0; n < 6 && waitResponse(100L, GF("C: ")) == 1; n++) {
+        streamSkipUntil('\n');
+      }
+    } else {
+      state[0] = '\0';
+    }
+    char* cr = strchr(state, '\r');
+    if (cr) {
+      *cr = '\0';
+    }
+    DBG("### IP state:", state);
+
+    bool multi = false;
+    if (!strncmp(state, "IP ", 3) && strcmp(state, "IP INITIAL")) {
+      // Only multi-IP with manual receive can be picked up as it is
+      sendAT(GF("+CIPMUX?"));
+      multi = waitResponse(GF("+CIPMUX: 1"), GFP(GSM_OK), GFP(GSM_ERROR)) == 1;
+      if (multi) {
+        waitResponse();
+      }
+    }
+
+    if (multi && (!strcmp(state, "IP STATUS") || !strcmp(state, "IP PROCESSING"))) {
+      return true;
+    }
+    if (multi && !strcmp(state, "IP GPRSACT")) {
+      return gprsBringUp(false);
+    }
+    if (multi && !strcmp(state, "IP START")) {
+      return gprsBringUp();
+    }
+    if (!strcmp(state, "IP INITIAL")) {
+      // The bearer may still be attached, with only the IP layer gone
+      sendAT(GF("+CGATT?"));
+      bool attached = waitResponse(GF("+CGATT: 1"), GFP(GSM_OK), GFP(GSM_ERROR)) == 1;
+      if (attached) {
+        waitResponse();
+      }
+      if (attached) {
+        return gprsStartIP();
+      }
+    }
+    return gprsConnect(apn, user, pwd);
+  }
+
   bool gprsDisconnect() {
     // Shut the TCP/IP connection
     // CIPSHUT will close *all* open connections
@@ -467,7 +603,7 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     if (waitResponse(GF(GSM_NL "+CGATT:")) != 1) {
       return false;
     }
-    int res = stream.readStringUntil('\n').toInt();
+    int res = streamReadInt('\n');
     waitResponse();
     if (res != 1)
       return false;
@@ -499,6 +635,8 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     return TinyGsmIpFromString(getLocalIP());
   }
 
+TINY_GSM_MODEM_DNS_CDNSGIP()
+
   /*
    * Phone Call functions
    */
@@ -568,7 +706,7 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     stream.readStringUntil('"');
     String hex = stream.readStringUntil('"');
     stream.readStringUntil(',');
-    int dcs = stream.readStringUntil('\n').toInt();
+    int dcs = streamReadInt('\n');
 
     if (dcs == 15) {
       return TinyGsmDecodeHex8bit(hex);
@@ -642,6 +780,27 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
    * Time functions
    */
 
+  // Lets the network set the clock when the modem registers, so CCLK reads
+  // real time instead of its power-on default.  The setting is saved, so
+  // this only writes it once.
+  bool enableNetworkTime() {
+    sendAT(GF("+CLTS?"));
+    if (waitResponse(GF(GSM_NL "+CLTS:")) != 1) {
+      return false;
+    }
+    int on = streamReadInt('\n');
+    waitResponse();
+    if (on == 1) {
+      return true;
+    }
+    sendAT(GF("+CLTS=1"));
+    if (waitResponse(1000L) != 1) {
+      return false;
+    }
+    sendAT(GF("&W"));
+    return waitResponse() == 1;
+  }
+
   String getGSMDateTime(TinyGSMDateTimeFormat format) {
     sendAT(GF("+CCLK?"));
     if (waitResponse(1000L, GF(GSM_NL "+CCLK: \"")) != 1) {
@@ -678,7 +837,7 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     streamSkipUntil(','); // Skip battery charge status
     streamSkipUntil(','); // Skip battery charge level
     // return voltage in mV
-    uint16_t res = stream.readStringUntil(',').toInt();
+    uint16_t res = streamReadInt(',');
     // Wait for final OK
     waitResponse();
     return res;
@@ -691,7 +850,7 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     }
     streamSkipUntil(','); // Skip battery charge status
     // Read battery charge level
-    int res = stream.readStringUntil(',').toInt();
+    int res = streamReadInt(',');
     // Wait for final OK
     waitResponse();
     return res;
@@ -703,7 +862,7 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
       return false;
     }
     // Read battery charge status
-    int res = stream.readStringUntil(',').toInt();
+    int res = streamReadInt(',');
     // Wait for final OK
     waitResponse();
     return res;
@@ -714,9 +873,9 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     if (waitResponse(GF(GSM_NL "+CBC:")) != 1) {
       return false;
     }
-    chargeState = stream.readStringUntil(',').toInt();
-    percent = stream.readStringUntil(',').toInt();
-    milliVolts = stream.readStringUntil('\n').toInt();
+    chargeState = streamReadInt(',');
+    percent = streamReadInt(',');
+    milliVolts = streamReadInt('\n');
     // Wait for final OK
     waitResponse();
     return true;
@@ -811,71 +970,149 @@ protected:
     return (1 == rsp);
   }
 
+  // Single-connection mode has no link numbers, so mux is unused here
+  bool modemTransparentConnect(const char* host, uint16_t port, uint8_t,
+                               int timeout_s = 75) {
+    uint32_t timeout_ms = ((uint32_t)timeout_s)*1000;
+    // CIPMUX/CIPMODE can only be changed with the IP stack shut down,
+    // which also closes every regular socket
+    sendAT(GF("+CIPSHUT"));
+    if (waitResponse(2000L) != 1) {
+      return false;
+    }
+    for (int mux = 0; mux < TINY_GSM_MUX_COUNT; mux++) {
+      if (sockets[mux]) {
+        sockets[mux]->sock_connected = false;
+      }
+    }
+    if (!gprsStartIP(true)) {
+      modemTransparentRestore();
+      return false;
+    }
+    sendAT(GF("+CIPSTART=\"TCP\",\""), host, GF("\","), port);
+    int rsp = waitResponse(timeout_ms,
+                           GF(GSM_NL "CONNECT" GSM_NL),
+                           GF("CONNECT FAIL" GSM_NL),
+                           GF("ALREADY CONNECT" GSM_NL),
+                           GF("ERROR" GSM_NL));
+    if (rsp != 1) {
+      modemTransparentRestore();
+      return false;
+    }
+    return true;
+  }
+
+  void modemTransparentClose(uint8_t, bool data_mode) {
+    if (data_mode) {
+      TinyGsmEscapeData(stream);
+      waitResponse();
+    }
+    sendAT(GF("+CIPCLOSE"));
+    waitResponse(GF("CLOSE OK" GSM_NL), GFP(GSM_ERROR));
+    modemTransparentRestore();
+  }
+
+  // Puts the IP stack back in the multi-socket mode gprsConnect() left it in
+  bool modemTransparentRestore() {
+    sendAT(GF("+CIPSHUT"));
+    waitResponse(2000L);
+    sendAT(GF("+CIPMODE=0"));
+    waitResponse();
+    return gprsStartIP();
+  }
+
   int16_t modemSend(const void* buff, size_t len, uint8_t mux) {
+#if TINY_GSM_SEND_WINDOW > 1
+    if (!modemSendWindowWait(TINY_GSM_SEND_WINDOW - 1)) {
+      return 0;
+    }
+#endif
     sendAT(GF("+CIPSEND="), mux, ',', (uint16_t)len);
     if (waitResponse(GF(">")) != 1) {
       return 0;
     }
     stream.write((uint8_t*)buff, len);
+    TINY_GSM_AT_STATS_BYTES(len, 0)
     stream.flush();
+#if TINY_GSM_SEND_WINDOW > 1
+    // Don't wait, the DATA ACCEPT is picked up by waitResponse later
+    sends_pending++;
+    sends_mux[mux]++;
+    return len;
+#else
     if (waitResponse(GF(GSM_NL "DATA ACCEPT:")) != 1) {
       return 0;
     }
     streamSkipUntil(','); // Skip mux
-    return stream.readStringUntil('\n').toInt();
+    return streamReadInt('\n');
+#endif
   }
 
-  size_t modemRead(size_t size, uint8_t mux) {
-#ifdef TINY_GSM_USE_HEX
-    sendAT(GF("+CIPRXGET=3,"), mux, ',', (uint16_t)size);
-    if (waitResponse(GF("+CIPRXGET:")) != 1) {
-      return 0;
+  // Waits until no more than limit sends are still waiting for DATA ACCEPT.
+  // Sends that get no answer in time are given up, together with their
+  // sockets.
+  bool modemSendWindowWait(uint8_t limit, uint32_t timeout_ms = 10000L) {
+    uint32_t startMillis = millis();
+    while (sends_pending > limit) {
+      uint32_t elapsed = millis() - startMillis;
+      String data;
+      int rsp = 0;
+      if (elapsed < timeout_ms) {
+        rsp = waitResponse(timeout_ms - elapsed, data, GF(GSM_NL "DATA ACCEPT:"),
+                           GF("SEND FAIL" GSM_NL));
+      }
+      if (rsp == 1) {
+        int mux = streamReadInt(',');
+        streamSkipUntil('\n'); // Skip length
+        modemSendDone(mux, true);
+      } else if (rsp == 2) {
+        modemSendDone(TinyGsmUrcMux(data, 11), false);
+      } else {
+        for (int mux = 0; mux < TINY_GSM_MUX_COUNT; mux++) {
+          if (sends_mux[mux]) {
+            sends_mux[mux] = 0;
+            modemSendFailed(mux);
+          }
+        }
+        sends_pending = 0;
+        return false;
+      }
     }
-#else
-    sendAT(GF("+CIPRXGET=2,"), mux, ',', (uint16_t)size);
-    if (waitResponse(GF("+CIPRXGET:")) != 1) {
-      return 0;
+    return true;
+  }
+
+  // Settles a send the modem has answered for
+  void modemSendDone(int mux, bool ok) {
+    if (mux < 0 || mux >= TINY_GSM_MUX_COUNT || !sends_mux[mux]) {
+      return;
     }
-#endif
-    streamSkipUntil(','); // Skip Rx mode 2/normal or 3/HEX
-    streamSkipUntil(','); // Skip mux
-    int len_requested = stream.readStringUntil(',').toInt();
-    //  ^^ Requested number of data bytes (1-1460 bytes)to be read
-    int len_confirmed = stream.readStringUntil('\n').toInt();
-    // ^^ Confirmed number of data bytes to be read, which may be less than requested.
-    // 0 indicates that no data can be read.
-    // This is actually be the number of bytes that will be remaining after the read
-    for (int i=0; i<len_requested; i++) {
-      uint32_t startMillis = millis();
-#ifdef TINY_GSM_USE_HEX
-      while (stream.available() < 2 && (millis() - startMillis < sockets[mux]->_timeout)) { TINY_GSM_YIELD(); }
-      char buf[4] = { 0, };
-      buf[0] = stream.read();
-      buf[1] = stream.read();
-      char c = strtol(buf, NULL, 16);
-#else
-      while (!stream.available() && (millis() - startMillis < sockets[mux]->_timeout)) { TINY_GSM_YIELD(); }
-      char c = stream.read();
-#endif
-      sockets[mux]->rx.put(c);
+    sends_mux[mux]--;
+    sends_pending--;
+    if (!ok) {
+      DBG("### Send failed on", mux);
+      modemSendFailed(mux);
+    }
+  }
+
+  // The socket's stream has lost data it was told was sent
+  void modemSendFailed(uint8_t mux) {
+    if (sockets[mux]) {
+      sockets[mux]->sock_connected = false;
+      sockets[mux]->setWriteError();
     }
-    DBG("### READ:", len_requested, "from", mux);
-    // sockets[mux]->sock_available = modemGetAvailable(mux);
-    sockets[mux]->sock_available = len_confirmed;
-    waitResponse();
-    return len_requested;
   }
 
+TINY_GSM_MODEM_READ_CIPRXGET()
+
   size_t modemGetAvailable(uint8_t mux) {
     sendAT(GF("+CIPRXGET=4,"), mux);
     size_t result = 0;
-    if (waitResponse(GF("+CIPRXGET:")) == 1) {
-      streamSkipUntil(','); // Skip mode 4
+    if (waitResponse(GF("+CIPRXGET:")) == 1 && modemCipRxGetMode() == 4) {
       streamSkipUntil(','); // Skip mux
-      result = stream.readStringUntil('\n').toInt();
+      result = streamReadInt('\n');
       waitResponse();
     }
-    DBG("### Available:", result, "on", mux);
+    DBG_TRACE(GF("### Available:"), result, GF("on"), mux);
     if (!result) {
       sockets[mux]->sock_connected = modemGetConnected(mux);
     }
@@ -899,7 +1136,28 @@ public:
 
 TINY_GSM_MODEM_STREAM_UTILITIES()
 
-  // TODO: Optimize this!
+TINY_GSM_MODEM_MATCHER()
+
+  // URCs handled by waitResponse(), matched alongside the expected responses
+  enum {
+    URC_CIPRXGET = TINY_GSM_MATCH_URC,
+    URC_RECEIVE,
+    URC_DATA_ACCEPT,
+    URC_SEND_FAIL,
+    URC_CLOSED
+  };
+
+  static GsmConstStr urcPattern(uint8_t id) {
+    switch (id) {
+      case URC_CIPRXGET:    return GF(GSM_NL "+CIPRXGET:");
+      case URC_RECEIVE:     return GF(GSM_NL "+RECEIVE:");
+      case URC_DATA_ACCEPT: return GF(GSM_NL "DATA ACCEPT:");
+      case URC_SEND_FAIL:   return GF("SEND FAIL" GSM_NL);
+      case URC_CLOSED:      return GF("CLOSED" GSM_NL);
+      default: return NULL;
+    }
+  }
+
   uint8_t waitResponse(uint32_t timeout_ms, String& data,
                        GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
                        GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL)
@@ -911,6 +1169,7 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
     String r5s(r5); r5s.trim();
     DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
     data.reserve(64);
+    matcherExpect(r1, r2, r3, r4, r5);
     int index = 0;
     unsigned long startMillis = millis();
     do {
@@ -918,47 +1177,54 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
       while (stream.available() > 0) {
         int a = stream.read();
         if (a <= 0) continue; // Skip 0x00 bytes, just in case
-        data += (char)a;
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
-          goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
-          goto finish;
-        } else if (r3 && data.endsWith(r3)) {
-          index = 3;
-          goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
-          goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
+        TINY_GSM_LINE_PUT(data, a)
+        uint8_t hit = matcher.feed(a);
+        if (hit && hit < TINY_GSM_MATCH_URC) {
+          index = hit;
           goto finish;
-        } else if (data.endsWith(GF(GSM_NL "+CIPRXGET:"))) {
-          String mode = stream.readStringUntil(',');
-          if (mode.toInt() == 1) {
-            int mux = stream.readStringUntil('\n').toInt();
+        } else if (hit >= match_app_base) {
+          urcDispatch(hit);
+          data = "";
+        } else if (hit == URC_CIPRXGET) {
+          int mode = streamReadInt(',');
+          if (mode == 1) {
+            int mux = streamReadInt('\n');
             if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-              sockets[mux]->got_data = true;
+              sock_pending |= TINY_GSM_SOCK_BIT(mux);
             }
             data = "";
-            DBG("### Got Data:", mux);
+            DBG_TRACE(GF("### Got Data:"), mux);
+#if defined(TINY_GSM_READ_AHEAD)
+          } else if (read_ahead_mux >= 0) {
+            // Reply to the client's read-ahead request
+            modemReadPayload();
+            data = "";
+            goto finish;
+#endif
           } else {
             data += mode;
           }
-        } else if (data.endsWith(GF(GSM_NL "+RECEIVE:"))) {
-          int mux = stream.readStringUntil(',').toInt();
-          int len = stream.readStringUntil('\n').toInt();
+        } else if (hit == URC_RECEIVE) {
+          int mux = streamReadInt(',');
+          int len = streamReadInt('\n');
           if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-            sockets[mux]->got_data = true;
+            sock_pending |= TINY_GSM_SOCK_BIT(mux);
             sockets[mux]->sock_available = len;
           }
           data = "";
-          DBG("### Got Data:", len, "on", mux);
-        } else if (data.endsWith(GF("CLOSED" GSM_NL))) {
-          int nl = data.lastIndexOf(GSM_NL, data.length()-8);
-          int coma = data.indexOf(',', nl+2);
-          int mux = data.substring(nl+2, coma).toInt();
+          DBG_TRACE(GF("### Got Data:"), len, GF("on"), mux);
+#if TINY_GSM_SEND_WINDOW > 1
+        } else if (hit == URC_DATA_ACCEPT) {
+          int mux = streamReadInt(',');
+          streamSkipUntil('\n'); // Skip length
+          modemSendDone(mux, true);
+          data = "";
+        } else if (hit == URC_SEND_FAIL) {
+          modemSendDone(TinyGsmUrcMux(data, 11), false);
+          data = "";
+#endif
+        } else if (hit == URC_CLOSED) {
+          int mux = TinyGsmUrcMux(data, 8);
           if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
             sockets[mux]->sock_connected = false;
           }
@@ -966,9 +1232,13 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
           DBG("### Closed: ", mux);
         }
       }
+      if (TINY_GSM_URC_DRAIN_IDLE()) {
+        break;
+      }
     } while (millis() - startMillis < timeout_ms);
 finish:
-    if (!index) {
+    TINY_GSM_AT_STATS_RESULT(index)
+    if (!index && !match_resume) {
       data.trim();
       if (data.length()) {
         DBG("### Unhandled:", data);
@@ -984,8 +1254,8 @@ finish:
                        GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
                        GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL)
   {
-    String data;
-    return waitResponse(timeout_ms, data, r1, r2, r3, r4, r5);
+    wait_line = "";
+    return waitResponse(timeout_ms, wait_line, r1, r2, r3, r4, r5);
   }
 
   uint8_t waitResponse(GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
@@ -999,6 +1269,11 @@ public:
 
 protected:
   GsmClient*    sockets[TINY_GSM_MUX_COUNT];
+  uint8_t       sends_pending;
+  uint8_t       sends_mux[TINY_GSM_MUX_COUNT];
+  String        gprs_apn;
+  String        gprs_user;
+  String        gprs_pwd;
 };
 
 #endif
@@ -77,7 +77,7 @@ public:
     }
 
     stream.readStringUntil(','); // mode
-    if ( stream.readStringUntil(',').toInt() == 1 ) fix = true;
+    if ( streamReadInt(',') == 1 ) fix = true;
     stream.readStringUntil(','); //utctime
     *lat =  stream.readStringUntil(',').toFloat(); //lat
     *lon =  stream.readStringUntil(',').toFloat(); //lon
@@ -90,8 +90,8 @@ public:
     stream.readStringUntil(',');
     stream.readStringUntil(',');
     stream.readStringUntil(',');
-    if (vsat != NULL) *vsat = stream.readStringUntil(',').toInt(); //viewed satelites
-    if (usat != NULL) *usat = stream.readStringUntil(',').toInt(); //used satelites
+    if (vsat != NULL) *vsat = streamReadInt(','); //viewed satelites
+    if (usat != NULL) *usat = streamReadInt(','); //used satelites
     stream.readStringUntil('\n');
 
     waitResponse();
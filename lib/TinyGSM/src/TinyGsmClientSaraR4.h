@@ -63,8 +63,9 @@ public:
     this->mux = mux;
     sock_available = 0;
     prev_check = 0;
+    poll_interval = TINY_GSM_POLL_MIN_MS;
+    polled = false;
     sock_connected = false;
-    got_data = false;
 
     at->sockets[mux] = this;
 
@@ -129,8 +130,9 @@ private:
   uint8_t         mux;
   uint16_t        sock_available;
   uint32_t        prev_check;
+  uint32_t        poll_interval;
   bool            sock_connected;
-  bool            got_data;
+  bool            polled;
   RxFifo          rx;
 };
 
@@ -511,7 +513,7 @@ TINY_GSM_MODEM_GET_GPRS_IP_CONNECTED()
       return 0;
     }
 
-    int res = stream.readStringUntil(',').toInt();
+    int res = streamReadInt(',');
     int8_t percent = res*20;  // return is 0-5
     // Wait for final OK
     waitResponse();
@@ -537,7 +539,7 @@ TINY_GSM_MODEM_GET_GPRS_IP_CONNECTED()
     if (waitResponse(GF(GSM_NL "+UTEMP:")) != 1) {
       return (float)-9999;
     }
-    int16_t res = stream.readStringUntil('\n').toInt();
+    int16_t res = streamReadInt('\n');
     float temp = -9999;
     if (res != -1) {
       temp = ((float)res)/10;
@@ -560,7 +562,7 @@ protected:
     if (waitResponse(GF(GSM_NL "+USOCR:")) != 1) {
       return false;
     }
-    *mux = stream.readStringUntil('\n').toInt();
+    *mux = streamReadInt('\n');
     waitResponse();
 
     if (ssl) {
@@ -586,8 +588,8 @@ protected:
     // NOT supported on SARA-R404M / SARA-R410M-01B
     sendAT(GF("+USOCO="), *mux, ",\"", host, "\",", port, ",1");
     waitResponse(timeout_ms, GF(GSM_NL "+UUSOCO: "));
-    stream.readStringUntil(',').toInt();  // skip repeated mux
-    int connection_status = stream.readStringUntil('\n').toInt();
+    streamReadInt(',');  // skip repeated mux
+    int connection_status = streamReadInt('\n');
     return (0 == connection_status);
 
     // use synchronous open
@@ -604,12 +606,13 @@ protected:
     // 50ms delay, see AT manual section 25.10.4
     delay(50);
     stream.write((uint8_t*)buff, len);
+    TINY_GSM_AT_STATS_BYTES(len, 0)
     stream.flush();
     if (waitResponse(GF(GSM_NL "+USOWR:")) != 1) {
       return 0;
     }
     streamSkipUntil(',');  // Skip mux
-    int sent = stream.readStringUntil('\n').toInt();
+    int sent = streamReadInt('\n');
     waitResponse();  // sends back OK after the confirmation of number sent
     return sent;
   }
@@ -620,15 +623,15 @@ protected:
       return 0;
     }
     streamSkipUntil(',');  // Skip mux
-    int len = stream.readStringUntil(',').toInt();
+    int len = streamReadInt(',');
     streamSkipUntil('\"');
 
-    for (int i=0; i<len; i++) {
-      TINY_GSM_MODEM_STREAM_TO_MUX_FIFO_WITH_DOUBLE_TIMEOUT
-    }
+    size_t moved = TinyGsmStreamToFifo(stream, sockets[mux]->rx, len, sockets[mux]->_timeout);
+
+    TINY_GSM_AT_STATS_BYTES(0, moved)
     streamSkipUntil('\"');
     waitResponse();
-    DBG("### READ:", len, "from", mux);
+    DBG_TRACE(GF("### READ:"), len, GF("from"), mux);
     sockets[mux]->sock_available = modemGetAvailable(mux);
     return len;
   }
@@ -642,7 +645,7 @@ protected:
     // that you have already told to close
     if (res == 1) {
       streamSkipUntil(',');  // Skip mux
-      result = stream.readStringUntil('\n').toInt();
+      result = streamReadInt('\n');
       // if (result) DBG("### DATA AVAILABLE:", result, "on", mux);
       waitResponse();
     }
@@ -661,7 +664,7 @@ protected:
 
     streamSkipUntil(',');  // Skip mux
     streamSkipUntil(',');  // Skip type
-    int result = stream.readStringUntil('\n').toInt();
+    int result = streamReadInt('\n');
     // 0: the socket is in INACTIVE status (it corresponds to CLOSED status
     // defined in RFC793 "TCP Protocol Specification" [112])
     // 1: the socket is in LISTEN status
@@ -686,7 +689,22 @@ public:
 
 TINY_GSM_MODEM_STREAM_UTILITIES()
 
-  // TODO: Optimize this!
+TINY_GSM_MODEM_MATCHER()
+
+  // URCs handled by waitResponse(), matched alongside the expected responses
+  enum {
+    URC_UUSORD = TINY_GSM_MATCH_URC,
+    URC_UUSOCL
+  };
+
+  static GsmConstStr urcPattern(uint8_t id) {
+    switch (id) {
+      case URC_UUSORD: return GF("+UUSORD:");
+      case URC_UUSOCL: return GF("+UUSOCL:");
+      default: return NULL;
+    }
+  }
+
   uint8_t waitResponse(uint32_t timeout_ms, String& data,
                        GsmConstStr r1 = GFP(GSM_OK),
                        GsmConstStr r2 = GFP(GSM_ERROR),
@@ -699,6 +717,7 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
     String r5s(r5); r5s.trim();
     DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
     data.reserve(64);
+    matcherExpect(r1, r2, r3, r4, r5);
     int index = 0;
     unsigned long startMillis = millis();
     do {
@@ -707,36 +726,28 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
         TINY_GSM_YIELD();
         int a = stream.read();
         if (a <= 0) continue;  // Skip 0x00 bytes, just in case
-        data += (char)a;
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
-          goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
-          goto finish;
-        } else if (r3 && data.endsWith(r3)) {
-          index = 3;
-          if (r3 == GFP(GSM_CME_ERROR)) {
+        TINY_GSM_LINE_PUT(data, a)
+        uint8_t hit = matcher.feed(a);
+        if (hit && hit < TINY_GSM_MATCH_URC) {
+          index = hit;
+          if (index == 3 && r3 == GFP(GSM_CME_ERROR)) {
             streamSkipUntil('\n');  // Read out the error
           }
           goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
-          goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
-          goto finish;
-        } else if (data.endsWith(GF("+UUSORD:"))) {
-          int mux = stream.readStringUntil(',').toInt();
-          int len = stream.readStringUntil('\n').toInt();
+        } else if (hit >= match_app_base) {
+          urcDispatch(hit);
+          data = "";
+        } else if (hit == URC_UUSORD) {
+          int mux = streamReadInt(',');
+          int len = streamReadInt('\n');
           if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-            sockets[mux]->got_data = true;
+            sock_pending |= TINY_GSM_SOCK_BIT(mux);
             sockets[mux]->sock_available = len;
           }
           data = "";
           DBG("### URC Data Received:", len, "on", mux);
-        } else if (data.endsWith(GF("+UUSOCL:"))) {
-          int mux = stream.readStringUntil('\n').toInt();
+        } else if (hit == URC_UUSOCL) {
+          int mux = streamReadInt('\n');
           if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
             sockets[mux]->sock_connected = false;
           }
@@ -744,9 +755,13 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
           DBG("### URC Sock Closed: ", mux);
         }
       }
+      if (TINY_GSM_URC_DRAIN_IDLE()) {
+        break;
+      }
     } while (millis() - startMillis < timeout_ms);
 finish:
-    if (!index) {
+    TINY_GSM_AT_STATS_RESULT(index)
+    if (!index && !match_resume) {
       data.trim();
       if (data.length()) {
         DBG("### Unhandled:", data);
@@ -763,8 +778,8 @@ finish:
                        GsmConstStr r2 = GFP(GSM_ERROR),
                        GsmConstStr r3 = GFP(GSM_CME_ERROR),
                        GsmConstStr r4 = NULL, GsmConstStr r5 = NULL) {
-    String data;
-    return waitResponse(timeout_ms, data, r1, r2, r3, r4, r5);
+    wait_line = "";
+    return waitResponse(timeout_ms, wait_line, r1, r2, r3, r4, r5);
   }
 
   uint8_t waitResponse(GsmConstStr r1 = GFP(GSM_OK),
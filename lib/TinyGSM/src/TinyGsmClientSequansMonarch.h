@@ -73,8 +73,9 @@ public:
     this->mux = mux;
     sock_available = 0;
     prev_check = 0;
+    poll_interval = TINY_GSM_POLL_MIN_MS;
+    polled = false;
     sock_connected = false;
-    got_data = false;
 
     // adjust for zero indexed socket array vs Sequans' 1 indexed mux numbers
     // using modulus will force 6 back to 0
@@ -122,8 +123,9 @@ private:
   uint8_t         mux;
   uint16_t        sock_available;
   uint32_t        prev_check;
+  uint32_t        poll_interval;
   bool            sock_connected;
-  bool            got_data;
+  bool            polled;
   RxFifo          rx;
 };
 
@@ -229,20 +231,30 @@ TINY_GSM_MODEM_SET_BAUD_IPR()
 TINY_GSM_MODEM_TEST_AT()
 
   void maintain() {
-    for (int mux = 1; mux <= TINY_GSM_MUX_COUNT; mux++) {
+    TINY_GSM_MODEM_AT_QUEUE_SETTLE()
+    // Socket ids run from 1 to TINY_GSM_MUX_COUNT, bit 0 is never set
+    TinyGsmSockMask pending = sock_pending;
+    sock_pending = 0;
+    for (int mux = 0; pending; mux++, pending >>= 1) {
       GsmClient* sock = sockets[mux % TINY_GSM_MUX_COUNT];
-      if (sock && sock->got_data) {
-        sock->got_data = false;
+      if ((pending & 1) && sock) {
         sock->sock_available = modemGetAvailable(mux);
+        TINY_GSM_MODEM_POLL_RESULT(sock)
         // modemGetConnected() always checks the state of ALL socks
         modemGetConnected();
       }
     }
-    while (stream.available()) {
-      waitResponse(15, NULL, NULL);
-  }
+    if (stream.available()) {
+      drainUrcs(TINY_GSM_URC_DRAIN_MS);
+    }
+    TINY_GSM_MODEM_TX_FLUSH_DUE()
   }
 
+TINY_GSM_MODEM_URC_DRAIN()
+
+  TinyGsmSockMask  sock_pending = 0;
+  TinyGsmPollStats poll_stats = { 0, 0 };
+
   bool factoryDefault() {
     sendAT(GF("&FZE0&W"));  // Factory + Reset + Echo Off + Write
     waitResponse();
@@ -416,7 +428,7 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
     if (waitResponse(GF(GSM_NL "+CGATT:")) != 1) {
       return false;
     }
-    int res = stream.readStringUntil('\n').toInt();
+    int res = streamReadInt('\n');
     waitResponse();
     if (res != 1)
       return false;
@@ -587,6 +599,7 @@ protected:
     sendAT(GF("+SQNSSENDEXT="), mux, ',', (uint16_t)len);
     waitResponse(10000L, GF(GSM_NL "> "));
     stream.write((uint8_t*)buff, len);
+    TINY_GSM_AT_STATS_BYTES(len, 0)
     stream.flush();
     if (waitResponse() != 1) {
       DBG("### no OK after send");
@@ -624,13 +637,10 @@ protected:
       return 0;
     }
     streamSkipUntil(','); // Skip mux
-    int len = stream.readStringUntil('\n').toInt();
-    for (int i=0; i<len; i++) {
-      uint32_t startMillis = millis(); \
-      while (!stream.available() && ((millis() - startMillis) < sockets[mux % TINY_GSM_MUX_COUNT]->_timeout)) { TINY_GSM_YIELD(); } \
-      char c = stream.read(); \
-      sockets[mux % TINY_GSM_MUX_COUNT]->rx.put(c);
-    }
+    int len = streamReadInt('\n');
+    GsmClient* sock = sockets[mux % TINY_GSM_MUX_COUNT];
+    size_t moved = TinyGsmStreamToFifo(stream, sock->rx, len, sock->_timeout);
+    TINY_GSM_AT_STATS_BYTES(0, moved)
     DBG("### Read:", len, "from", mux);
     waitResponse();
     sockets[mux % TINY_GSM_MUX_COUNT]->sock_available = modemGetAvailable(mux);
@@ -644,10 +654,10 @@ protected:
       streamSkipUntil(','); // Skip mux
       streamSkipUntil(','); // Skip total sent
       streamSkipUntil(','); // Skip total received
-      result = stream.readStringUntil(',').toInt();  // keep data not yet read
+      result = streamReadInt(',');  // keep data not yet read
       waitResponse();
     }
-    DBG("### Available:", result, "on", mux);
+    DBG_TRACE(GF("### Available:"), result, GF("on"), mux);
     return result;
   }
 
@@ -660,7 +670,7 @@ protected:
         break;
       };
       uint8_t status = 0;
-      // if (stream.readStringUntil(',').toInt() != muxNo) { // check the mux no
+      // if (streamReadInt(',') != muxNo) { // check the mux no
       //   DBG("### Warning: misaligned mux numbers!");
       // }
       streamSkipUntil(',');  // skip mux [use muxNo]
@@ -690,7 +700,22 @@ public:
 
 TINY_GSM_MODEM_STREAM_UTILITIES()
 
-  // TODO: Optimize this!
+TINY_GSM_MODEM_MATCHER()
+
+  // URCs handled by waitResponse(), matched alongside the expected responses
+  enum {
+    URC_SQNSRING = TINY_GSM_MATCH_URC,
+    URC_SQNSH
+  };
+
+  static GsmConstStr urcPattern(uint8_t id) {
+    switch (id) {
+      case URC_SQNSRING: return GF(GSM_NL "+SQNSRING:");
+      case URC_SQNSH:    return GF("SQNSH: ");
+      default: return NULL;
+    }
+  }
+
   uint8_t waitResponse(uint32_t timeout_ms, String& data,
                        GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
                        GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL)
@@ -702,6 +727,7 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
     String r5s(r5); r5s.trim();
     DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
     data.reserve(64);
+    matcherExpect(r1, r2, r3, r4, r5);
     int index = 0;
     unsigned long startMillis = millis();
     do {
@@ -710,33 +736,25 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
         TINY_GSM_YIELD();
         int a = stream.read();
         if (a <= 0) continue; // Skip 0x00 bytes, just in case
-        data += (char)a;
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
-          goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
-          goto finish;
-        } else if (r3 && data.endsWith(r3)) {
-          index = 3;
-          goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
+        TINY_GSM_LINE_PUT(data, a)
+        uint8_t hit = matcher.feed(a);
+        if (hit && hit < TINY_GSM_MATCH_URC) {
+          index = hit;
           goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
-          goto finish;
-        } else if (data.endsWith(GF(GSM_NL "+SQNSRING:"))) {
-          int mux = stream.readStringUntil(',').toInt();
-          int len = stream.readStringUntil('\n').toInt();
+        } else if (hit >= match_app_base) {
+          urcDispatch(hit);
+          data = "";
+        } else if (hit == URC_SQNSRING) {
+          int mux = streamReadInt(',');
+          int len = streamReadInt('\n');
           if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux % TINY_GSM_MUX_COUNT]) {
-            sockets[mux % TINY_GSM_MUX_COUNT]->got_data = true;
+            sock_pending |= TINY_GSM_SOCK_BIT(mux);
             sockets[mux % TINY_GSM_MUX_COUNT]->sock_available = len;
           }
           data = "";
           DBG("### URC Data Received:", len, "on", mux);
-        } else if (data.endsWith(GF("SQNSH: "))) {
-          int mux = stream.readStringUntil('\n').toInt();
+        } else if (hit == URC_SQNSH) {
+          int mux = streamReadInt('\n');
           if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux % TINY_GSM_MUX_COUNT]) {
             sockets[mux % TINY_GSM_MUX_COUNT]->sock_connected = false;
           }
@@ -744,9 +762,13 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
           DBG("### URC Sock Closed: ", mux);
         }
       }
+      if (TINY_GSM_URC_DRAIN_IDLE()) {
+        break;
+      }
     } while (millis() - startMillis < timeout_ms);
 finish:
-    if (!index) {
+    TINY_GSM_AT_STATS_RESULT(index)
+    if (!index && !match_resume) {
       data.trim();
       if (data.length()) {
         DBG("### Unhandled:", data);
@@ -762,8 +784,8 @@ finish:
                        GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
                        GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL)
   {
-    String data;
-    return waitResponse(timeout_ms, data, r1, r2, r3, r4, r5);
+    wait_line = "";
+    return waitResponse(timeout_ms, wait_line, r1, r2, r3, r4, r5);
   }
 
   uint8_t waitResponse(GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
@@ -0,0 +1,577 @@
+/**
+ * @file       TinyGsmClientTls.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Nov 2016
+ */
+
+#ifndef TinyGsmClientTls_h
+#define TinyGsmClientTls_h
+
+#include <Arduino.h>
+#include <Client.h>
+#include <mbedtls/version.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/x509_crt.h>
+#include <mbedtls/sha256.h>
+#include <mbedtls/platform.h>
+
+// TLS done by mbedTLS on the board (ESP32, or any core that ships it) over
+// a plain modem socket, instead of by the modem (AT+CIPSSL and the like).
+// Works over any Client, e.g. a TinyGsmClient.
+//
+// A session is kept after every handshake and offered on the next
+// connect(), so a server that supports session IDs or tickets answers with
+// an abbreviated handshake: no certificate, one round trip less.
+// getSession()/setSession() carry it across reboots.  The server's
+// certificate is dropped from a kept session, which would otherwise not
+// fit most places it could be saved; its SHA-256 stays with the session,
+// so a pinned server still checks out on a resumed handshake.
+//
+// Sessions are only resumed with TLS 1.2, which is the highest version
+// offered.
+//
+// The server must be checked against a root CA (setCACert()) or the
+// SHA-256 fingerprint of its certificate (setFingerprint()); connect()
+// fails with MBEDTLS_ERR_SSL_CA_CHAIN_REQUIRED otherwise, unless
+// setInsecure() was called.
+
+#if MBEDTLS_VERSION_MAJOR >= 3
+  #define TINY_GSM_TLS_FIELD(f) MBEDTLS_PRIVATE(f)
+#else
+  #define TINY_GSM_TLS_FIELD(f) f
+#endif
+
+#ifndef TINY_GSM_TLS_TIMEOUT_MS
+  #define TINY_GSM_TLS_TIMEOUT_MS 30000L
+#endif
+
+class TinyGsmClientTls : public Client
+{
+public:
+    TinyGsmClientTls(Client& transport)
+        : _transport(transport)
+    {
+        _ca = NULL;
+        _pinned = false;
+        _insecure = false;
+        _helloIdLen = -1;
+        _host[0] = '\0';
+        _seeded = false;
+        _drbgSeeded = false;
+        _ready = false;
+        _haveSession = false;
+        _havePeerHash = false;
+        _resumed = false;
+        _peek = -1;
+        _error = 0;
+        _handshakeMs = 0;
+        _bytesTx = _bytesRx = 0;
+        _handshakeTx = _handshakeRx = 0;
+        mbedtls_ssl_init(&_ssl);
+        mbedtls_ssl_config_init(&_conf);
+        mbedtls_ssl_session_init(&_session);
+        mbedtls_entropy_init(&_entropy);
+        mbedtls_ctr_drbg_init(&_drbg);
+        mbedtls_x509_crt_init(&_caChain);
+    }
+
+    virtual ~TinyGsmClientTls()
+    {
+        stop();
+        mbedtls_ssl_free(&_ssl);
+        mbedtls_ssl_config_free(&_conf);
+        mbedtls_ssl_session_free(&_session);
+        mbedtls_x509_crt_free(&_caChain);
+        mbedtls_ctr_drbg_free(&_drbg);
+        mbedtls_entropy_free(&_entropy);
+    }
+
+    // PEM root certificate(s) the server's chain must end in.  The string
+    // is used at the next connect(), so it must stay valid until then.
+    void setCACert(const char* pem)
+    {
+        _ca = pem;
+        mbedtls_x509_crt_free(&_caChain);
+        mbedtls_x509_crt_init(&_caChain);
+        _seeded = false;
+    }
+
+    // SHA-256 of the server's certificate (DER), as 64 hex digits that may
+    // be separated by ':' or spaces.  The chain isn't checked then, only
+    // that the server presents this very certificate.
+    bool setFingerprint(const char* hex)
+    {
+        size_t n = 0;
+        for (; hex && *hex && n < 2 * sizeof(_fingerprint); hex++)
+        {
+            int v = _hexDigit(*hex);
+            if (v < 0)
+            {
+                if (*hex == ':' || *hex == ' ')
+                    continue;
+                break;
+            }
+            if (!(n & 1))
+                _fingerprint[n / 2] = v << 4;
+            else
+                _fingerprint[n / 2] |= v;
+            n++;
+        }
+        _pinned = n == 2 * sizeof(_fingerprint);
+        _seeded = false;
+        return _pinned;
+    }
+
+    // Connects without checking who the server is.  Only for testing.
+    void setInsecure()
+    {
+        _insecure = true;
+        _seeded = false;
+    }
+
+    // Name sent as SNI and checked against the certificate when connecting
+    // by IPAddress; connect() by name sets it too
+    void setHostname(const char* host)
+    {
+        strncpy(_host, host, sizeof(_host) - 1);
+        _host[sizeof(_host) - 1] = '\0';
+    }
+
+    // Serialized session from the last handshake, 0 if there is none or it
+    // doesn't fit.  The size needed is returned in needed.  It starts with
+    // whether the server's certificate hash is known, then the hash.
+    size_t getSession(uint8_t* buf, size_t size, size_t* needed = NULL)
+    {
+        const size_t head = 1 + sizeof(_peerHash);
+        size_t len = 0;
+        if (!_haveSession)
+            return 0;
+        bool fits = buf && size > head;
+        int ret = mbedtls_ssl_session_save(&_session, fits ? buf + head : NULL,
+                                           fits ? size - head : 0, &len);
+        if (needed)
+            *needed = head + len;
+        if (ret || !fits)
+            return 0;
+        buf[0] = _havePeerHash;
+        memcpy(buf + 1, _peerHash, sizeof(_peerHash));
+        return head + len;
+    }
+
+    // Session to offer on the next connect(), as saved by getSession()
+    bool setSession(const uint8_t* buf, size_t len)
+    {
+        const size_t head = 1 + sizeof(_peerHash);
+        mbedtls_ssl_session_free(&_session);
+        mbedtls_ssl_session_init(&_session);
+        _haveSession = buf && len > head &&
+                       !mbedtls_ssl_session_load(&_session, buf + head, len - head);
+        _havePeerHash = _haveSession && buf[0] == 1;
+        if (_havePeerHash)
+            memcpy(_peerHash, buf + 1, sizeof(_peerHash));
+        return _haveSession;
+    }
+
+    void clearSession()
+    {
+        setSession(NULL, 0);
+    }
+
+    // Whether the last handshake resumed the offered session, i.e. the
+    // server echoed the session ID the client hello carried
+    bool sessionResumed() const
+    {
+        return _resumed;
+    }
+
+    uint32_t handshakeMs() const
+    {
+        return _handshakeMs;
+    }
+
+    // Bytes the last handshake sent and received over the transport
+    uint32_t handshakeBytesTx() const
+    {
+        return _handshakeTx;
+    }
+
+    uint32_t handshakeBytesRx() const
+    {
+        return _handshakeRx;
+    }
+
+    // mbedTLS error code of the last failure, 0 if none
+    int lastError() const
+    {
+        return _error;
+    }
+
+    virtual int connect(IPAddress ip, uint16_t port)
+    {
+        if (!_transport.connect(ip, port))
+            return 0;
+        return _start();
+    }
+
+    virtual int connect(const char* host, uint16_t port)
+    {
+        setHostname(host);
+        if (!_transport.connect(host, port))
+            return 0;
+        return _start();
+    }
+
+    virtual size_t write(uint8_t c)
+    {
+        return write(&c, 1);
+    }
+
+    virtual size_t write(const uint8_t* buf, size_t size)
+    {
+        size_t done = 0;
+        uint32_t start = millis();
+        while (_ready && done < size)
+        {
+            int ret = mbedtls_ssl_write(&_ssl, buf + done, size - done);
+            if (ret > 0)
+            {
+                done += ret;
+                start = millis();
+            }
+            else if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
+            {
+                _fail(ret);
+            }
+            else if (millis() - start > TINY_GSM_TLS_TIMEOUT_MS)
+            {
+                // The transport is up but takes nothing, e.g. failed sends
+                _fail(MBEDTLS_ERR_SSL_TIMEOUT);
+            }
+            else
+            {
+                delay(1);
+            }
+        }
+        return done;
+    }
+
+    virtual int available()
+    {
+        if (!_ready)
+            return _peek >= 0;
+        int n = mbedtls_ssl_get_bytes_avail(&_ssl);
+        if (!n && _transport.available())
+        {
+            // Decrypts the next record, if it has arrived whole
+            int ret = mbedtls_ssl_read(&_ssl, NULL, 0);
+            if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
+                _fail(ret);
+            else
+                n = mbedtls_ssl_get_bytes_avail(&_ssl);
+        }
+        return n + (_peek >= 0);
+    }
+
+    virtual int read()
+    {
+        uint8_t c;
+        return read(&c, 1) == 1 ? c : -1;
+    }
+
+    virtual int read(uint8_t* buf, size_t size)
+    {
+        if (!size)
+            return 0;
+        size_t done = 0;
+        if (_peek >= 0)
+        {
+            buf[done++] = _peek;
+            _peek = -1;
+        }
+        if (!_ready || done == size)
+            return done ? (int)done : -1;
+        int ret = mbedtls_ssl_read(&_ssl, buf + done, size - done);
+        if (ret > 0)
+            done += ret;
+        else if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
+            _fail(ret);
+        return done ? (int)done : -1;
+    }
+
+    virtual int peek()
+    {
+        if (_peek < 0)
+        {
+            uint8_t c;
+            if (available() && read(&c, 1) == 1)
+                _peek = c;
+        }
+        return _peek;
+    }
+
+    virtual void flush()
+    {
+        _transport.flush();
+    }
+
+    virtual void stop()
+    {
+        if (_ready)
+            mbedtls_ssl_close_notify(&_ssl);
+        _ready = false;
+        _peek = -1;
+        _transport.stop();
+    }
+
+    virtual uint8_t connected()
+    {
+        if (!_ready)
+            return _peek >= 0;
+        return mbedtls_ssl_get_bytes_avail(&_ssl) || _transport.connected();
+    }
+
+    virtual operator bool()
+    {
+        return connected();
+    }
+
+private:
+    static int _send(void* ctx, const unsigned char* buf, size_t len)
+    {
+        TinyGsmClientTls* self = (TinyGsmClientTls*)ctx;
+        size_t n = self->_transport.write(buf, len);
+        if (!n)
+            return self->_transport.connected() ? MBEDTLS_ERR_SSL_WANT_WRITE
+                                                : MBEDTLS_ERR_NET_CONN_RESET;
+        // The session ID of the client hello, to tell a resumed handshake by
+        // its echo: record header (5), handshake header (4), version (2),
+        // random (32), then the ID length and the ID
+        if (self->_helloIdLen < 0 && n >= 44 && buf[0] == 0x16 && buf[5] == 0x01 &&
+            buf[43] <= sizeof(self->_helloId) && n >= 44u + buf[43])
+        {
+            self->_helloIdLen = buf[43];
+            memcpy(self->_helloId, buf + 44, buf[43]);
+        }
+        self->_bytesTx += n;
+        return n;
+    }
+
+    static int _hexDigit(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    // Hashes the certificate of a full handshake into _peerHash.  A resumed
+    // one presents none, and the hash kept with the session stands: it was
+    // checked on the full handshake that set the session up.
+    void _hashPeerCert()
+    {
+        const mbedtls_x509_crt* crt = mbedtls_ssl_get_peer_cert(&_ssl);
+        if (!crt)
+        {
+            _havePeerHash = _havePeerHash && _resumed;
+            return;
+        }
+#if MBEDTLS_VERSION_MAJOR >= 3
+        _havePeerHash = !mbedtls_sha256(crt->raw.p, crt->raw.len, _peerHash, 0);
+#else
+        _havePeerHash = !mbedtls_sha256_ret(crt->raw.p, crt->raw.len, _peerHash, 0);
+#endif
+    }
+
+    // Frees the server's certificate from the kept session, which keeps
+    // only its hash
+    void _dropPeerCert()
+    {
+#if defined(MBEDTLS_SSL_KEEP_PEER_CERTIFICATE)
+        mbedtls_x509_crt*& crt = _session.TINY_GSM_TLS_FIELD(peer_cert);
+        if (crt)
+        {
+            mbedtls_x509_crt_free(crt);
+            mbedtls_free(crt);
+            crt = NULL;
+        }
+#endif
+    }
+
+    static int _recv(void* ctx, unsigned char* buf, size_t len)
+    {
+        TinyGsmClientTls* self = (TinyGsmClientTls*)ctx;
+        if (!self->_transport.available())
+            return self->_transport.connected() ? MBEDTLS_ERR_SSL_WANT_READ
+                                                : MBEDTLS_ERR_NET_CONN_RESET;
+        int n = self->_transport.read(buf, len);
+        if (n <= 0)
+            return MBEDTLS_ERR_SSL_WANT_READ;
+        self->_bytesRx += n;
+        return n;
+    }
+
+    // The DRBG is seeded once, the configuration again after setCACert()
+    bool _seed()
+    {
+        if (_seeded)
+            return true;
+        int ret = 0;
+        if (!_drbgSeeded)
+        {
+            const char pers[] = "TinyGsmClientTls";
+            ret = mbedtls_ctr_drbg_seed(&_drbg, mbedtls_entropy_func, &_entropy,
+                                        (const unsigned char*)pers, sizeof(pers) - 1);
+            _drbgSeeded = !ret;
+        }
+        mbedtls_ssl_config_free(&_conf);
+        mbedtls_ssl_config_init(&_conf);
+        if (!ret)
+            ret = mbedtls_ssl_config_defaults(&_conf, MBEDTLS_SSL_IS_CLIENT,
+                                              MBEDTLS_SSL_TRANSPORT_STREAM,
+                                              MBEDTLS_SSL_PRESET_DEFAULT);
+        if (!ret && !_ca && !_pinned && !_insecure)
+            ret = MBEDTLS_ERR_SSL_CA_CHAIN_REQUIRED;
+        if (!ret && _ca)
+            ret = mbedtls_x509_crt_parse(&_caChain, (const unsigned char*)_ca, strlen(_ca) + 1);
+        if (ret)
+        {
+            _error = ret;
+            return false;
+        }
+        if (_ca)
+        {
+            mbedtls_ssl_conf_ca_chain(&_conf, &_caChain, NULL);
+            mbedtls_ssl_conf_authmode(&_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+        }
+        else
+        {
+            // A pinned certificate is checked after the handshake
+            mbedtls_ssl_conf_authmode(&_conf, MBEDTLS_SSL_VERIFY_NONE);
+        }
+        mbedtls_ssl_conf_rng(&_conf, mbedtls_ctr_drbg_random, &_drbg);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+        mbedtls_ssl_conf_session_tickets(&_conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+#if MBEDTLS_VERSION_MAJOR >= 3
+        mbedtls_ssl_conf_max_tls_version(&_conf, MBEDTLS_SSL_VERSION_TLS1_2);
+#else
+        mbedtls_ssl_conf_max_version(&_conf, MBEDTLS_SSL_MAJOR_VERSION_3,
+                                     MBEDTLS_SSL_MINOR_VERSION_3);
+#endif
+        _seeded = true;
+        return true;
+    }
+
+    int _start()
+    {
+        uint32_t start = millis();
+        uint32_t tx = _bytesTx, rx = _bytesRx;
+        _resumed = false;
+        _helloIdLen = -1;
+        _peek = -1;
+        _error = 0;
+
+        mbedtls_ssl_free(&_ssl);
+        mbedtls_ssl_init(&_ssl);
+        int ret = _seed() ? mbedtls_ssl_setup(&_ssl, &_conf) : _error;
+        if (!ret && _host[0])
+            ret = mbedtls_ssl_set_hostname(&_ssl, _host);
+        if (!ret && _haveSession)
+            ret = mbedtls_ssl_set_session(&_ssl, &_session);
+        if (ret)
+        {
+            _error = ret;
+            _transport.stop();
+            return 0;
+        }
+        mbedtls_ssl_set_bio(&_ssl, this, _send, _recv, NULL);
+
+        while ((ret = mbedtls_ssl_handshake(&_ssl)) != 0)
+        {
+            if ((ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) ||
+                millis() - start > TINY_GSM_TLS_TIMEOUT_MS)
+            {
+                _error = ret;
+                _transport.stop();
+                // The server may have dropped the session
+                clearSession();
+                return 0;
+            }
+            delay(1);
+        }
+
+        // The server echoes the client's session ID only when it resumes,
+        // also for a ticket (RFC 5077 3.4), for which mbedTLS sends a
+        // random one
+        bool offered = _haveSession;
+        mbedtls_ssl_session_free(&_session);
+        mbedtls_ssl_session_init(&_session);
+        _haveSession = !mbedtls_ssl_get_session(&_ssl, &_session);
+        _resumed = offered && _haveSession && _helloIdLen > 0 &&
+                   _session.TINY_GSM_TLS_FIELD(id_len) == (size_t)_helloIdLen &&
+                   !memcmp(_helloId, _session.TINY_GSM_TLS_FIELD(id), _helloIdLen);
+
+        _hashPeerCert();
+        if (_pinned && (!_havePeerHash ||
+                        memcmp(_peerHash, _fingerprint, sizeof(_peerHash))))
+        {
+            _error = MBEDTLS_ERR_X509_CERT_VERIFY_FAILED;
+            mbedtls_ssl_close_notify(&_ssl);
+            _transport.stop();
+            clearSession();
+            return 0;
+        }
+        _dropPeerCert();
+
+        _handshakeMs = millis() - start;
+        _handshakeTx = _bytesTx - tx;
+        _handshakeRx = _bytesRx - rx;
+        _ready = true;
+        return 1;
+    }
+
+    void _fail(int ret)
+    {
+        if (ret != MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY)
+            _error = ret;
+        _ready = false;
+        _transport.stop();
+    }
+
+    Client&                  _transport;
+    const char*              _ca;
+    uint8_t                  _fingerprint[32];
+    bool                     _pinned;
+    uint8_t                  _peerHash[32];
+    bool                     _havePeerHash;
+    bool                     _insecure;
+    uint8_t                  _helloId[32];
+    int                      _helloIdLen;
+    char                     _host[64];
+    mbedtls_ssl_context      _ssl;
+    mbedtls_ssl_config       _conf;
+    mbedtls_ssl_session      _session;
+    mbedtls_entropy_context  _entropy;
+    mbedtls_ctr_drbg_context _drbg;
+    mbedtls_x509_crt         _caChain;
+    bool                     _seeded;
+    bool                     _drbgSeeded;
+    bool                     _ready;
+    bool                     _haveSession;
+    bool                     _resumed;
+    int                      _peek;
+    int                      _error;
+    uint32_t                 _handshakeMs;
+    uint32_t                 _bytesTx, _bytesRx;
+    uint32_t                 _handshakeTx, _handshakeRx;
+};
+
+#endif
@@ -200,6 +200,19 @@ public:
   virtual int peek() { return at->stream.peek(); }
   virtual void flush() { at->stream.flush(); }
 
+  // The same API as the other modems' clients.  Data comes straight off
+  // the UART here, with no FIFO to scan, so these are the stream's own.
+  size_t readUntil(char delim, char* buf, size_t max) {
+    TINY_GSM_YIELD();
+    return at->stream.readBytesUntil(delim, buf, max);
+  }
+
+  using Stream::find;
+  bool find(const char* token) {
+    TINY_GSM_YIELD();
+    return at->stream.find((char*)token);
+  }
+
   virtual uint8_t connected() {
     if (available()) {
       return true;
@@ -1050,6 +1063,7 @@ public:
       DBG("XBee only supports 1 IP channel in transparent mode!");
     }
     stream.write((uint8_t*)buff, len);
+    TINY_GSM_AT_STATS_BYTES(len, 0)
     stream.flush();
 
     if (beeType != XBEE_S6B_WIFI) {
@@ -1216,7 +1230,13 @@ public:
 
 TINY_GSM_MODEM_STREAM_UTILITIES()
 
-  // TODO: Optimize this!
+TINY_GSM_MODEM_MATCHER()
+
+  // The XBee has no URCs to match
+  static GsmConstStr urcPattern(uint8_t) {
+    return NULL;
+  }
+
   // NOTE:  This function is used while INSIDE command mode, so we're only
   // waiting for requested responses.  The XBee has no unsoliliced responses
   // (URC's) when in command mode.
@@ -1231,6 +1251,7 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
     String r5s(r5); r5s.trim();
     DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
     data.reserve(16);  // Should never be getting much here for the XBee
+    matcherExpect(r1, r2, r3, r4, r5);
     int8_t index = 0;
     unsigned long startMillis = millis();
     do {
@@ -1239,27 +1260,20 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
         TINY_GSM_YIELD();
         int a = stream.read();
         if (a <= 0) continue; // Skip 0x00 bytes, just in case
-        data += (char)a;
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
-          goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
-          goto finish;
-        } else if (r3 && data.endsWith(r3)) {
-          index = 3;
-          goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
-          goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
+        TINY_GSM_LINE_PUT(data, a)
+        uint8_t hit = matcher.feed(a);
+        if (hit && hit < TINY_GSM_MATCH_URC) {
+          index = hit;
           goto finish;
+        } else if (hit >= match_app_base) {
+          urcDispatch(hit);
+          data = "";
         }
       }
     } while (millis() - startMillis < timeout_ms);
 finish:
-    if (!index) {
+    TINY_GSM_AT_STATS_RESULT(index)
+    if (!index && !match_resume) {
       data.trim();
       data.replace(GSM_NL GSM_NL, GSM_NL);
       data.replace(GSM_NL, "\r\n    ");
@@ -1284,8 +1298,8 @@ finish:
                        GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
                        GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL)
   {
-    String data;
-    return waitResponse(timeout_ms, data, r1, r2, r3, r4, r5);
+    wait_line = "";
+    return waitResponse(timeout_ms, wait_line, r1, r2, r3, r4, r5);
   }
 
   uint8_t waitResponse(GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
@@ -38,6 +38,15 @@
   #define TINY_GSM_YIELD() { delay(TINY_GSM_YIELD_MS); }
 #endif
 
+// Read-ahead is only implemented for modems that read with AT+CIPRXGET
+#if defined(TINY_GSM_READ_AHEAD) && !defined(TINY_GSM_MODEM_HAS_READ_AHEAD)
+  #undef TINY_GSM_READ_AHEAD
+#endif
+
+#ifndef TINY_GSM_READ_AHEAD_MIN
+  #define TINY_GSM_READ_AHEAD_MIN (TINY_GSM_RX_BUFFER / 2)
+#endif
+
 #define TINY_GSM_ATTR_NOT_AVAILABLE __attribute__((error("Not available on this modem type")))
 #define TINY_GSM_ATTR_NOT_IMPLEMENTED __attribute__((error("Not implemented")))
 
@@ -53,7 +62,23 @@
   #define GF(x)  x
 #endif
 
-#ifdef TINY_GSM_DEBUG
+#include <TinyGsmMatcher.h>
+
+// 1 prints state changes only, 2 also what happens on every chunk of socket
+// data (DBG_TRACE)
+#ifndef TINY_GSM_DEBUG_LEVEL
+  #define TINY_GSM_DEBUG_LEVEL 2
+#endif
+
+#if defined(TINY_GSM_DEBUG) && defined(TINY_GSM_DEBUG_DEFERRED)
+  #include <TinyGsmLog.h>
+namespace {
+  template<typename... Args>
+  static void DBG(Args&&... args) {
+    TinyGsmLogWrite(args...);
+  }
+}
+#elif defined(TINY_GSM_DEBUG)
 namespace {
   template<typename T>
   static void DBG_PLAIN(T last) {
@@ -80,6 +105,12 @@ namespace {
   #define DBG(...)
 #endif
 
+#if defined(TINY_GSM_DEBUG) && TINY_GSM_DEBUG_LEVEL >= 2
+  #define DBG_TRACE(...) DBG(__VA_ARGS__)
+#else
+  #define DBG_TRACE(...)
+#endif
+
 template<class T>
 const T& TinyGsmMin(const T& a, const T& b)
 {
@@ -92,22 +123,62 @@ const T& TinyGsmMax(const T& a, const T& b)
     return (b < a) ? a : b;
 }
 
+// Sends "AT" and returns as soon as "OK" comes back, rather than waiting
+// out a readString() timeout.  Anything left over from an earlier probe is
+// dropped first.
+template<class T>
+bool TinyGsmProbeAT(T& SerialAT, uint32_t timeout_ms = 50)
+{
+  while (SerialAT.available()) {
+    SerialAT.read();
+  }
+  SerialAT.print("AT\r\n");
+  uint8_t matched = 0;
+  for (uint32_t start = millis(); millis() - start < timeout_ms; ) {
+    if (!SerialAT.available()) {
+      TINY_GSM_YIELD();
+      continue;
+    }
+    char c = SerialAT.read();
+    matched = (c == "OK"[matched]) ? matched + 1 : (c == 'O');
+    if (matched == 2) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Takes a modem out of transparent data mode: "+++" with a second of
+// silence before it and half a second after.  The line break that follows
+// ends it as a bad command if the modem was in command mode already.
+template<class T>
+void TinyGsmEscapeData(T& SerialAT)
+{
+  delay(1000);
+  SerialAT.print("+++");
+  SerialAT.flush();
+  delay(500);
+  SerialAT.print("\r\n");
+}
+
+// Tries the preferred rate first (e.g. the last one that worked), then the
+// common ones.  A modem that auto-bauds needs a few probes to lock on.
 template<class T>
-uint32_t TinyGsmAutoBaud(T& SerialAT, uint32_t minimum = 9600, uint32_t maximum = 115200)
+uint32_t TinyGsmAutoBaud(T& SerialAT, uint32_t minimum = 9600, uint32_t maximum = 115200,
+                         uint32_t preferred = 0)
 {
   static uint32_t rates[] = { 115200, 57600, 38400, 19200, 9600, 74400, 74880, 230400, 460800, 2400, 4800, 14400, 28800 };
 
-  for (unsigned i = 0; i < sizeof(rates)/sizeof(rates[0]); i++) {
-    uint32_t rate = rates[i];
+  for (int i = -1; i < (int)(sizeof(rates)/sizeof(rates[0])); i++) {
+    uint32_t rate = (i < 0) ? preferred : rates[i];
     if (rate < minimum || rate > maximum) continue;
+    if (i >= 0 && rate == preferred) continue;
 
     DBG("Trying baud rate", rate, "...");
     SerialAT.begin(rate);
     delay(10);
-    for (int i=0; i<10; i++) {
-      SerialAT.print("AT\r\n");
-      String input = SerialAT.readString();
-      if (input.indexOf("OK") >= 0) {
+    for (int n=0; n<10; n++) {
+      if (TinyGsmProbeAT(SerialAT, 50)) {
         DBG("Modem responded at rate", rate);
         return rate;
       }
@@ -138,16 +209,101 @@ IPAddress TinyGsmIpFromString(const String& strIP) {
   return IPAddress(Parts[0], Parts[1], Parts[2], Parts[3]);
 }
 
+// First address in a DNS result the modem reported as
+// ' 1,"<host>","<ip>"[,"<ip2>"]', or 0.0.0.0 if the lookup failed
+static inline
+IPAddress TinyGsmParseDnsResult(const char* args) {
+  if (atoi(args) != 1) {
+    return IPAddress(0,0,0,0);
+  }
+  const char* p = args;
+  for (uint8_t quotes = 0; p && quotes < 3; quotes++) {
+    p = strchr(p, '"');
+    if (p) p++;
+  }
+  if (!p) {
+    return IPAddress(0,0,0,0);
+  }
+  return TinyGsmIpFromString(String(p));
+}
+
+// Link number of a "<n>, <text>" URC whose text, textLen characters with
+// the line break, ends data; -1 if there is none
+static inline
+int TinyGsmUrcMux(const String& data, size_t textLen) {
+  if (data.length() <= textLen) {
+    return -1;
+  }
+  int nl = data.lastIndexOf('\n', data.length() - textLen - 1);
+  const char* p = data.c_str() + nl + 1;
+  if (*p < '0' || *p > '9') {
+    return -1;
+  }
+  return atoi(p);
+}
+
+// Nibble value of every ASCII character, 0xFF for anything that isn't a hex digit
+static const uint8_t TinyGsmHexNibble[256] TINY_GSM_PROGMEM = {
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+#if defined(__AVR__)
+  #define TINY_GSM_HEX_NIBBLE(c) pgm_read_byte(&TinyGsmHexNibble[(uint8_t)(c)])
+#else
+  #define TINY_GSM_HEX_NIBBLE(c) TinyGsmHexNibble[(uint8_t)(c)]
+#endif
+
+static inline
+uint8_t TinyGsmHexByte(char hi, char lo) {
+  return (TINY_GSM_HEX_NIBBLE(hi) << 4) | (TINY_GSM_HEX_NIBBLE(lo) & 0x0F);
+}
+
+// Decodes up to nbytes bytes from 2*nbytes hex digits, eight digits (one
+// 32-bit output word) per iteration.  Stops at the first non-hex character
+// and returns the number of bytes written to out.
+static inline
+size_t TinyGsmDecodeHexBlock(const char* in, uint8_t* out, size_t nbytes) {
+  size_t i = 0;
+  for (; i + 4 <= nbytes; i += 4, in += 8) {
+    uint8_t n0 = TINY_GSM_HEX_NIBBLE(in[0]), n1 = TINY_GSM_HEX_NIBBLE(in[1]);
+    uint8_t n2 = TINY_GSM_HEX_NIBBLE(in[2]), n3 = TINY_GSM_HEX_NIBBLE(in[3]);
+    uint8_t n4 = TINY_GSM_HEX_NIBBLE(in[4]), n5 = TINY_GSM_HEX_NIBBLE(in[5]);
+    uint8_t n6 = TINY_GSM_HEX_NIBBLE(in[6]), n7 = TINY_GSM_HEX_NIBBLE(in[7]);
+    if ((n0 | n1 | n2 | n3 | n4 | n5 | n6 | n7) & 0xF0) break;
+    uint8_t w[4] = { (uint8_t)((n0 << 4) | n1), (uint8_t)((n2 << 4) | n3),
+                     (uint8_t)((n4 << 4) | n5), (uint8_t)((n6 << 4) | n7) };
+    memcpy(out + i, w, 4);
+  }
+  for (; i < nbytes; i++, in += 2) {
+    uint8_t hi = TINY_GSM_HEX_NIBBLE(in[0]), lo = TINY_GSM_HEX_NIBBLE(in[1]);
+    if ((hi | lo) & 0xF0) break;
+    out[i] = (hi << 4) | lo;
+  }
+  return i;
+}
+
 static inline
 String TinyGsmDecodeHex7bit(String &instr) {
   String result;
   byte reminder = 0;
   int bitstate = 7;
-  for (unsigned i=0; i<instr.length(); i+=2) {
-    char buf[4] = { 0, };
-    buf[0] = instr[i];
-    buf[1] = instr[i+1];
-    byte b = strtol(buf, NULL, 16);
+  for (unsigned i=0; i+1<instr.length(); i+=2) {
+    byte b = TinyGsmHexByte(instr[i], instr[i+1]);
 
     byte bb = b << (7 - bitstate);
     char c = (bb + reminder) & 0x7F;
@@ -167,12 +323,18 @@ String TinyGsmDecodeHex7bit(String &instr) {
 static inline
 String TinyGsmDecodeHex8bit(String &instr) {
   String result;
-  for (unsigned i=0; i<instr.length(); i+=2) {
-    char buf[4] = { 0, };
-    buf[0] = instr[i];
-    buf[1] = instr[i+1];
-    char b = strtol(buf, NULL, 16);
-    result += b;
+  result.reserve(instr.length() / 2);
+  const char* in = instr.c_str();
+  size_t left = instr.length() / 2;
+  uint8_t buf[32];
+  while (left) {
+    size_t n = TinyGsmDecodeHexBlock(in, buf, TinyGsmMin(left, sizeof(buf)));
+    for (size_t i=0; i<n; i++) {
+      result += (char)buf[i];
+    }
+    if (n < TinyGsmMin(left, sizeof(buf))) break;
+    in += 2*n;
+    left -= n;
   }
   return result;
 }
@@ -180,11 +342,8 @@ String TinyGsmDecodeHex8bit(String &instr) {
 static inline
 String TinyGsmDecodeHex16bit(String &instr) {
   String result;
-  for (unsigned i=0; i<instr.length(); i+=4) {
-    char buf[4] = { 0, };
-    buf[0] = instr[i];
-    buf[1] = instr[i+1];
-    char b = strtol(buf, NULL, 16);
+  for (unsigned i=0; i+3<instr.length(); i+=4) {
+    char b = TinyGsmHexByte(instr[i], instr[i+1]);
     if (b) { // If high byte is non-zero, we can't handle it ;(
 #if defined(TINY_GSM_UNICODE_TO_HEX)
       result += "\\x";
@@ -193,9 +352,7 @@ String TinyGsmDecodeHex16bit(String &instr) {
       result += "?";
 #endif
     } else {
-      buf[0] = instr[i+2];
-      buf[1] = instr[i+3];
-      b = strtol(buf, NULL, 16);
+      b = TinyGsmHexByte(instr[i+2], instr[i+3]);
       result += b;
     }
   }
@@ -225,6 +382,141 @@ String TinyGsmDecodeHex16bit(String &instr) {
   }
 
 
+// Number of sends that may be waiting for the modem's acknowledgement at once
+// on drivers that support it (SIM800); 1 waits for every send.  The ESP8266
+// takes no command at all until a send is acknowledged, so it always waits.
+#ifndef TINY_GSM_SEND_WINDOW
+  #define TINY_GSM_SEND_WINDOW 1
+#endif
+
+#ifndef TINY_GSM_TX_BUFFER
+  #define TINY_GSM_TX_BUFFER 0
+#endif
+
+#ifndef TINY_GSM_TX_FLUSH_MS
+  #define TINY_GSM_TX_FLUSH_MS 20
+#endif
+
+// Wait before retrying a failed send, doubled with every further failure
+#ifndef TINY_GSM_TX_RETRY_MS
+  #define TINY_GSM_TX_RETRY_MS 250
+#endif
+
+// Failed sends in a row after which the socket is closed
+#ifndef TINY_GSM_TX_RETRIES
+  #define TINY_GSM_TX_RETRIES 4
+#endif
+
+#if TINY_GSM_TX_BUFFER > 0
+// Writes are combined in a per-socket buffer of TINY_GSM_TX_BUFFER bytes and
+// sent with a single modemSend when the buffer fills up, on flush(), before
+// any read/available() (the caller is then waiting for a reply), on stop(),
+// or from maintain() once the oldest byte has waited TINY_GSM_TX_FLUSH_MS.
+// A failed send keeps the bytes and sets the write error; write() takes no
+// more than fits beside them.  Only flush() and stop() retry right away,
+// everything else waits TINY_GSM_TX_RETRY_MS, doubling, and the socket is
+// closed after TINY_GSM_TX_RETRIES failures.
+#define TINY_GSM_CLIENT_WRITE() \
+  virtual size_t write(const uint8_t *buf, size_t size) { \
+    TINY_GSM_YIELD(); \
+    if (tx_len && (tx_len + size > sizeof(tx_buf) || txDue())) { \
+      flushTx(false); \
+    } \
+    if (size > sizeof(tx_buf)) { \
+      /* Would overtake the bytes still waiting */ \
+      if (tx_len) return 0; \
+      at->maintain(); \
+      int16_t sent = at->modemSend(buf, size, mux); \
+      if (sent < (int16_t)size) setWriteError(); \
+      return sent > 0 ? sent : 0; \
+    } \
+    if (tx_len + size > sizeof(tx_buf)) return 0; \
+    if (!tx_len) tx_since = millis(); \
+    memcpy(tx_buf + tx_len, buf, size); \
+    tx_len += size; \
+    if (tx_len == sizeof(tx_buf)) flushTx(false); \
+    return size; \
+  } \
+  \
+  virtual size_t write(uint8_t c) {\
+    return write(&c, 1); \
+  }\
+  \
+  virtual size_t write(const char *str) { \
+    if (str == NULL) return 0; \
+    return write((const uint8_t *)str, strlen(str)); \
+  } \
+  \
+  /* Sends what is buffered; unless forced, not while backing off */ \
+  bool flushTx(bool force = true) { \
+    if (!tx_len) return true; \
+    if (!force && tx_fails && !txDue()) return false; \
+    uint8_t fails = tx_fails; \
+    at->maintain(); \
+    if (!tx_len || tx_fails != fails) { \
+      /* maintain() found them due and has just tried */ \
+      return !tx_len && sock_connected; \
+    } \
+    return sendTx(); \
+  } \
+  \
+  /* Buffered bytes have waited long enough, or the back-off is over */ \
+  bool txDue() { \
+    uint32_t wait = tx_fails ? (uint32_t)TINY_GSM_TX_RETRY_MS << (tx_fails - 1) \
+                             : (uint32_t)TINY_GSM_TX_FLUSH_MS; \
+    return tx_len && millis() - tx_since >= wait; \
+  } \
+  \
+  /* The send itself, without maintain(), so maintain() can call it */ \
+  bool sendTx() { \
+    if (!tx_len) return true; \
+    if (!sock_connected) { \
+      /* Nowhere left to send them */ \
+      tx_len = 0; \
+      tx_fails = 0; \
+      setWriteError(); \
+      return false; \
+    } \
+    int16_t sent = at->modemSend(tx_buf, tx_len, mux); \
+    tx_since = millis(); \
+    if (sent > 0 && (size_t)sent <= tx_len) { \
+      memmove(tx_buf, tx_buf + sent, tx_len - sent); \
+      tx_len -= sent; \
+    } \
+    if (!tx_len) { \
+      tx_fails = 0; \
+      return true; \
+    } \
+    setWriteError(); \
+    if (++tx_fails >= TINY_GSM_TX_RETRIES) { \
+      /* The modem keeps refusing them: give up on the connection */ \
+      tx_len = 0; \
+      tx_fails = 0; \
+      stop(); \
+    } \
+    return false; \
+  } \
+  \
+  uint8_t  tx_buf[TINY_GSM_TX_BUFFER]; \
+  size_t   tx_len = 0; \
+  uint32_t tx_since = 0; \
+  uint8_t  tx_fails = 0;
+
+#define TINY_GSM_CLIENT_TX_FLUSH() flushTx(false);
+#define TINY_GSM_CLIENT_TX_FLUSH_NOW() flushTx();
+// On stop(): a last try, then whatever is left is dropped with the socket
+#define TINY_GSM_CLIENT_TX_FINISH() flushTx(); tx_len = 0; tx_fails = 0;
+
+// Part of every maintain(): sends what has sat in a socket's buffer for
+// TINY_GSM_TX_FLUSH_MS, so a last short write goes out without a flush()
+#define TINY_GSM_MODEM_TX_FLUSH_DUE() \
+  for (int mux = 0; mux < TINY_GSM_MUX_COUNT; mux++) { \
+    GsmClient* sock = sockets[mux]; \
+    if (sock && sock->txDue()) { \
+      sock->sendTx(); \
+    } \
+  }
+#else
 // Writes data out on the client using the modem send functionality
 #define TINY_GSM_CLIENT_WRITE() \
   virtual size_t write(const uint8_t *buf, size_t size) { \
@@ -242,6 +534,92 @@ String TinyGsmDecodeHex16bit(String &instr) {
     return write((const uint8_t *)str, strlen(str)); \
   }
 
+#define TINY_GSM_CLIENT_TX_FLUSH()
+#define TINY_GSM_CLIENT_TX_FLUSH_NOW()
+#define TINY_GSM_CLIENT_TX_FINISH()
+#define TINY_GSM_MODEM_TX_FLUSH_DUE()
+#endif
+
+
+#ifndef TINY_GSM_POLL_MIN_MS
+  #define TINY_GSM_POLL_MIN_MS 100
+#endif
+
+#ifndef TINY_GSM_POLL_MAX_MS
+  #define TINY_GSM_POLL_MAX_MS 5000
+#endif
+
+// How often the fallback poll found data waiting (useful) or not (wasted)
+struct TinyGsmPollStats {
+  uint32_t useful;
+  uint32_t wasted;
+};
+
+// One bit per mux slot, set by the URC parser (or the poll fallback) when a
+// socket may have data waiting, so maintain() only visits flagged sockets
+#if TINY_GSM_MUX_COUNT > 16
+typedef uint32_t TinyGsmSockMask;
+#else
+typedef uint16_t TinyGsmSockMask;
+#endif
+#define TINY_GSM_SOCK_BIT(mux) ((TinyGsmSockMask)1 << (mux))
+
+// Upper bound for the unsolicited-input drain in maintain()
+#if !defined(TINY_GSM_URC_DRAIN_MS)
+  #define TINY_GSM_URC_DRAIN_MS 15
+#endif
+
+// Called at the end of each pass of waitResponse().  When maintain() drains
+// unsolicited input through drainUrcs(), waitResponse() stops as soon as the
+// UART is idle on a line boundary instead of sitting out the timeout.  A
+// lone line break may still be the start of a URC, so that is waited out.
+// Every other caller keeps the timeout, even with no responses to look for.
+#define TINY_GSM_URC_DRAIN_IDLE() \
+  (urc_drain && !r1 && !stream.available() && \
+   (!data.length() || (data.length() > 2 && data.endsWith(GF(GSM_NL)))))
+
+// Part of every maintain() macro
+#define TINY_GSM_MODEM_URC_DRAIN() \
+  void drainUrcs(uint32_t timeout_ms) { \
+    urc_drain = true; \
+    waitResponse(timeout_ms, NULL, NULL); \
+    urc_drain = false; \
+  } \
+  \
+  bool urc_drain = false;
+
+// Workaround: sometimes module forgets to notify about data arrival.
+// Data URCs are trusted first; a connected socket that is being read but has
+// heard nothing is polled after poll_interval, which starts at
+// TINY_GSM_POLL_MIN_MS, doubles with every poll that comes back empty, up
+// to TINY_GSM_POLL_MAX_MS, and halves when data is found.  So it settles
+// near the gap between arrivals instead of dropping back to the minimum on
+// every one of them.  Sockets nobody reads are never polled.
+#define TINY_GSM_CLIENT_POLL_FALLBACK() \
+  if (sock_connected && !(at->sock_pending & TINY_GSM_SOCK_BIT(mux)) && \
+      millis() - prev_check > poll_interval) { \
+    at->sock_pending |= TINY_GSM_SOCK_BIT(mux); \
+    polled = true; \
+    prev_check = millis(); \
+  }
+
+// Used by maintain() once it has asked the modem how much data a flagged
+// socket holds: shortens or backs off the poll interval and counts the poll
+#define TINY_GSM_MODEM_POLL_RESULT(sock) \
+  if (sock->sock_available) { \
+    sock->poll_interval = TinyGsmMax(sock->poll_interval / 2, (uint32_t)TINY_GSM_POLL_MIN_MS); \
+  } else { \
+    sock->poll_interval = TinyGsmMin(sock->poll_interval * 2, (uint32_t)TINY_GSM_POLL_MAX_MS); \
+  } \
+  if (sock->polled) { \
+    sock->polled = false; \
+    if (sock->sock_available) { \
+      poll_stats.useful++; \
+    } else { \
+      poll_stats.wasted++; \
+    } \
+  }
+
 
 // Returns the combined number of characters available in the TinyGSM fifo
 // and the modem chips internal fifo, doing an extra check-in with the
@@ -249,14 +627,9 @@ String TinyGsmDecodeHex16bit(String &instr) {
 #define TINY_GSM_CLIENT_AVAILABLE_WITH_BUFFER_CHECK() \
   virtual int available() { \
     TINY_GSM_YIELD(); \
+    TINY_GSM_CLIENT_TX_FLUSH() \
     if (!rx.size()) { \
-      /* Workaround: sometimes module forgets to notify about data arrival.
-      TODO: Currently we ping the module periodically,
-      but maybe there's a better indicator that we need to poll */ \
-      if (millis() - prev_check > 500) { \
-        got_data = true; \
-        prev_check = millis(); \
-      } \
+      TINY_GSM_CLIENT_POLL_FALLBACK() \
       at->maintain(); \
     } \
     return rx.size() + sock_available; \
@@ -268,6 +641,7 @@ String TinyGsmDecodeHex16bit(String &instr) {
 #define TINY_GSM_CLIENT_AVAILABLE_NO_BUFFER_CHECK() \
   virtual int available() { \
     TINY_GSM_YIELD(); \
+    TINY_GSM_CLIENT_TX_FLUSH() \
     if (!rx.size()) { \
       at->maintain(); \
     } \
@@ -280,6 +654,7 @@ String TinyGsmDecodeHex16bit(String &instr) {
 #define TINY_GSM_CLIENT_AVAILABLE_NO_MODEM_FIFO() \
   virtual int available() { \
     TINY_GSM_YIELD(); \
+    TINY_GSM_CLIENT_TX_FLUSH() \
     if (!rx.size() && sock_connected) { \
       at->maintain(); \
     } \
@@ -296,12 +671,31 @@ String TinyGsmDecodeHex16bit(String &instr) {
     return -1; \
   }
 
+#if defined(TINY_GSM_READ_AHEAD)
+  // Waits out a read-ahead request still in flight, so the FIFO space and
+  // sock_available the client is about to use are current
+  #define TINY_GSM_CLIENT_READ_AHEAD_SETTLE() at->modemReadAheadComplete();
+  // Once data has been handed to the caller, asks the modem for the next
+  // chunk without waiting for it
+  #define TINY_GSM_CLIENT_READ_AHEAD_ISSUE() \
+    if (sock_available > 0 && rx.free() >= TINY_GSM_READ_AHEAD_MIN) { \
+      at->modemReadAhead(TinyGsmMin((uint16_t)rx.free(), sock_available), mux); \
+    }
+  #define TINY_GSM_MODEM_READ_AHEAD_SETTLE() modemReadAheadComplete();
+#else
+  #define TINY_GSM_CLIENT_READ_AHEAD_SETTLE()
+  #define TINY_GSM_CLIENT_READ_AHEAD_ISSUE()
+  #define TINY_GSM_MODEM_READ_AHEAD_SETTLE()
+#endif
+
+
 // Reads characters out of the TinyGSM fifo, and from the modem chips internal
 // fifo if avaiable, also double checking with the modem if data has arrived
 // without issuing a UURC.
 #define TINY_GSM_CLIENT_READ_WITH_BUFFER_CHECK() \
   virtual int read(uint8_t *buf, size_t size) { \
     TINY_GSM_YIELD(); \
+    TINY_GSM_CLIENT_TX_FLUSH() \
     at->maintain(); \
     size_t cnt = 0; \
     while (cnt < size) { \
@@ -312,15 +706,10 @@ String TinyGsmDecodeHex16bit(String &instr) {
         cnt += chunk; \
         continue; \
       } \
-      /* Workaround: sometimes module forgets to notify about data arrival.
-      TODO: Currently we ping the module periodically,
-      but maybe there's a better indicator that we need to poll */ \
-      if (millis() - prev_check > 500) { \
-        got_data = true; \
-        prev_check = millis(); \
-      } \
+      TINY_GSM_CLIENT_POLL_FALLBACK() \
       /* TODO: Read directly into user buffer? */ \
       at->maintain(); \
+      TINY_GSM_CLIENT_READ_AHEAD_SETTLE() \
       if (sock_available > 0) { \
         int n = at->modemRead(TinyGsmMin((uint16_t)rx.free(), sock_available), mux); \
         if (n == 0) break; \
@@ -328,9 +717,26 @@ String TinyGsmDecodeHex16bit(String &instr) {
         break; \
       } \
     } \
+    TINY_GSM_CLIENT_READ_AHEAD_ISSUE() \
     return cnt; \
   } \
-  TINY_GSM_CLIENT_READ_OVERLOAD()
+  TINY_GSM_CLIENT_READ_OVERLOAD() \
+  \
+  /* Moves what the modem holds for this socket into the FIFO if it is \
+     empty, and returns how much the FIFO holds */ \
+  size_t fillRx() { \
+    TINY_GSM_YIELD(); \
+    TINY_GSM_CLIENT_TX_FLUSH() \
+    if (!rx.size()) { \
+      TINY_GSM_CLIENT_POLL_FALLBACK() \
+      at->maintain(); \
+      TINY_GSM_CLIENT_READ_AHEAD_SETTLE() \
+      if (!rx.size() && sock_available > 0) { \
+        at->modemRead(TinyGsmMin((uint16_t)rx.free(), sock_available), mux); \
+      } \
+    } \
+    return rx.size(); \
+  }
 
 
 // Reads characters out of the TinyGSM fifo, and from the modem chips internal
@@ -338,6 +744,7 @@ String TinyGsmDecodeHex16bit(String &instr) {
 #define TINY_GSM_CLIENT_READ_NO_BUFFER_CHECK() \
   virtual int read(uint8_t *buf, size_t size) { \
     TINY_GSM_YIELD(); \
+    TINY_GSM_CLIENT_TX_FLUSH() \
     at->maintain(); \
     size_t cnt = 0; \
     while (cnt < size) { \
@@ -359,7 +766,19 @@ String TinyGsmDecodeHex16bit(String &instr) {
     } \
     return cnt; \
   } \
-  TINY_GSM_CLIENT_READ_OVERLOAD()
+  TINY_GSM_CLIENT_READ_OVERLOAD() \
+  \
+  size_t fillRx() { \
+    TINY_GSM_YIELD(); \
+    TINY_GSM_CLIENT_TX_FLUSH() \
+    if (!rx.size()) { \
+      at->maintain(); \
+      if (!rx.size() && sock_available > 0) { \
+        at->modemRead(TinyGsmMin((uint16_t)rx.free(), sock_available), mux); \
+      } \
+    } \
+    return rx.size(); \
+  }
 
 
 // Reads characters out of the TinyGSM fifo, waiting for any URC's from the
@@ -368,6 +787,7 @@ String TinyGsmDecodeHex16bit(String &instr) {
 #define TINY_GSM_CLIENT_READ_NO_MODEM_FIFO() \
   virtual int read(uint8_t *buf, size_t size) { \
     TINY_GSM_YIELD(); \
+    TINY_GSM_CLIENT_TX_FLUSH() \
     size_t cnt = 0; \
     uint32_t _startMillis = millis(); \
     while (cnt < size && millis() - _startMillis < _timeout) { \
@@ -392,6 +812,15 @@ String TinyGsmDecodeHex16bit(String &instr) {
       return c; \
     } \
     return -1; \
+  } \
+  \
+  size_t fillRx() { \
+    TINY_GSM_YIELD(); \
+    TINY_GSM_CLIENT_TX_FLUSH() \
+    if (!rx.size() && sock_connected) { \
+      at->maintain(); \
+    } \
+    return rx.size(); \
   }
 
 
@@ -403,6 +832,7 @@ String TinyGsmDecodeHex16bit(String &instr) {
 // that it wants from the socket even if it was closed externally.
 #define TINY_GSM_CLIENT_DUMP_MODEM_BUFFER() \
     TINY_GSM_YIELD(); \
+    TINY_GSM_CLIENT_TX_FINISH() \
     rx.clear(); \
     at->maintain(); \
     unsigned long startMillis = millis(); \
@@ -413,9 +843,231 @@ String TinyGsmDecodeHex16bit(String &instr) {
     }
 
 
-// The peek, flush, and connected functions
+// The peek, flush, and connected functions, and readUntil() and find(),
+// which scan the FIFO in place with memchr() rather than a read() per byte.
+// Both give up once nothing has arrived for the stream timeout.
 #define TINY_GSM_CLIENT_PEEK_FLUSH_CONNECTED() \
-  virtual int peek() { return -1; } /* TODO */ \
+  virtual int peek() { \
+    uint8_t c; \
+    if (!fillRx() || !rx.peek(&c)) { \
+      return -1; \
+    } \
+    return c; \
+  } \
+  \
+  /* Like readBytesUntil(): reads up to max bytes into buf, stopping at \
+     delim, which is consumed but not stored.  Returns the bytes stored. */ \
+  size_t readUntil(char delim, char* buf, size_t max) { \
+    size_t len = 0; \
+    unsigned long start = millis(); \
+    while (len < max) { \
+      if (!fillRx()) { \
+        if (!sock_connected || millis() - start >= _timeout) { \
+          break; \
+        } \
+        continue; \
+      } \
+      uint8_t* p; \
+      size_t n = TinyGsmMin((size_t)rx.readSpan(&p), max - len); \
+      uint8_t* hit = (uint8_t*)memchr(p, delim, n); \
+      size_t take = hit ? hit - p : n; \
+      memcpy(buf + len, p, take); \
+      len += take; \
+      rx.consumed(hit ? take + 1 : take); \
+      if (hit) { \
+        break; \
+      } \
+      start = millis(); \
+    } \
+    return len; \
+  } \
+  \
+  /* Consumes data up to and including token; false if it didn't come */ \
+  using Stream::find; \
+  bool find(const char* token) { \
+    size_t len = strlen(token); \
+    size_t m = 0; /* bytes of token matched so far */ \
+    unsigned long start = millis(); \
+    while (m < len) { \
+      if (!fillRx()) { \
+        if (!sock_connected || millis() - start >= _timeout) { \
+          return false; \
+        } \
+        continue; \
+      } \
+      uint8_t* p; \
+      size_t n = rx.readSpan(&p); \
+      size_t i = 0; \
+      while (i < n && m < len) { \
+        if (!m) { \
+          uint8_t* hit = (uint8_t*)memchr(p + i, token[0], n - i); \
+          if (!hit) { \
+            i = n; \
+            break; \
+          } \
+          i = hit - p + 1; \
+          m = 1; \
+          continue; \
+        } \
+        char c = p[i++]; \
+        if (c == token[m]) { \
+          m++; \
+          continue; \
+        } \
+        /* Longest prefix of token that ends here */ \
+        size_t k = m; \
+        while (k > 0 && (memcmp(token, token + m - k + 1, k - 1) || token[k - 1] != c)) { \
+          k--; \
+        } \
+        m = k; \
+      } \
+      rx.consumed(i); \
+      start = millis(); \
+    } \
+    return true; \
+  } \
+  \
+  virtual void flush() { \
+    TINY_GSM_CLIENT_TX_FLUSH_NOW() \
+    at->stream.flush(); \
+  } \
+  \
+  virtual uint8_t connected() { \
+    if (available()) { \
+      return true; \
+    } \
+    return sock_connected; \
+  } \
+  virtual operator bool() { return connected(); } \
+  \
+  /* Asks the modem whether the link is still up, for a socket that has sat \
+     idle and so hasn't been polled */ \
+  bool checkConnected() { \
+    if (sock_connected) { \
+      sock_connected = at->modemGetConnected(mux); \
+    } \
+    return sock_connected; \
+  }
+
+
+// Single socket in transparent (data) mode: once connected, payload bytes
+// go over the UART with no AT framing at all.  The modem class provides
+// modemTransparentConnect(host, port, mux, timeout_s) and
+// modemTransparentClose(mux, data_mode).  The text the modem prints when
+// the remote side drops the link is matched in the data stream and ends the
+// session.  Bytes that could be the start of it are held back until it is
+// clear they are payload: when a different byte follows, or when nothing
+// follows for TINY_GSM_TRANSPARENT_HOLD_MS.
+#ifndef TINY_GSM_TRANSPARENT_HOLD_MS
+  #define TINY_GSM_TRANSPARENT_HOLD_MS 20
+#endif
+
+#define TINY_GSM_CLIENT_TRANSPARENT(modemClass, closedText) \
+class GsmClientTransparent : public Client \
+{ \
+  friend class modemClass; \
+  \
+public: \
+  GsmClientTransparent() {} \
+  \
+  GsmClientTransparent(modemClass& modem, uint8_t mux = 0) { \
+    init(&modem, mux); \
+  } \
+  \
+  virtual ~GsmClientTransparent(){} \
+  \
+  bool init(modemClass* modem, uint8_t mux = 0) { \
+    this->at = modem; \
+    this->mux = mux; \
+    sock_connected = false; \
+    data_mode = false; \
+    link_open = false; \
+    closed_match = 0; \
+    owed_len = owed_pos = 0; \
+    return true; \
+  } \
+  \
+public: \
+  virtual int connect(const char *host, uint16_t port, int timeout_s) { \
+    stop(); \
+    TINY_GSM_YIELD(); \
+    sock_connected = at->modemTransparentConnect(host, port, mux, timeout_s); \
+    data_mode = sock_connected; \
+    link_open = sock_connected; \
+    closed_match = 0; \
+    owed_len = owed_pos = 0; \
+    return sock_connected; \
+  } \
+  \
+TINY_GSM_CLIENT_CONNECT_OVERLOADS() \
+  \
+  /* Also needed after the remote side closed: the modem stays in \
+     single-connection mode until modemTransparentClose() */ \
+  virtual void stop() { \
+    if (!link_open) { \
+      return; \
+    } \
+    at->modemTransparentClose(mux, data_mode); \
+    sock_connected = false; \
+    data_mode = false; \
+    link_open = false; \
+    closed_match = 0; \
+    owed_len = owed_pos = 0; \
+  } \
+  \
+  virtual size_t write(const uint8_t *buf, size_t size) { \
+    if (!data_mode) return 0; \
+    return at->stream.write(buf, size); \
+  } \
+  \
+  virtual size_t write(uint8_t c) { \
+    return write(&c, 1); \
+  } \
+  \
+  virtual size_t write(const char *str) { \
+    if (str == NULL) return 0; \
+    return write((const uint8_t *)str, strlen(str)); \
+  } \
+  \
+  /* May count bytes that turn out to be the close text */ \
+  virtual int available() { \
+    TINY_GSM_YIELD(); \
+    releaseHeld(); \
+    int n = owed_len - owed_pos; \
+    if (data_mode) n += at->stream.available(); \
+    return n; \
+  } \
+  \
+  virtual int read(uint8_t *buf, size_t size) { \
+    TINY_GSM_YIELD(); \
+    releaseHeld(); \
+    size_t cnt = 0; \
+    while (cnt < size) { \
+      if (owed_pos < owed_len) { \
+        buf[cnt++] = owed[owed_pos++]; \
+        continue; \
+      } \
+      if (!data_mode || at->stream.available() <= 0) break; \
+      watchClosed(at->stream.read()); \
+    } \
+    return cnt; \
+  } \
+  \
+  virtual int read() { \
+    uint8_t c; \
+    if (read(&c, 1) == 1) { \
+      return c; \
+    } \
+    return -1; \
+  } \
+  \
+  virtual int peek() { \
+    releaseHeld(); \
+    if (owed_pos < owed_len) return owed[owed_pos]; \
+    /* Held back bytes may still be the close text */ \
+    if (!data_mode || closed_match) return -1; \
+    return at->stream.peek(); \
+  } \
   \
   virtual void flush() { at->stream.flush(); } \
   \
@@ -425,13 +1077,81 @@ String TinyGsmDecodeHex16bit(String &instr) {
     } \
     return sock_connected; \
   } \
-  virtual operator bool() { return connected(); }
+  virtual operator bool() { return connected(); } \
+  \
+private: \
+  static const char* closedString() { \
+    return GSM_NL closedText GSM_NL; \
+  } \
+  \
+  /* Takes one byte from the modem: payload goes to owed, a possible \
+     start of the close text is held back */ \
+  void watchClosed(int c) { \
+    if (c < 0) return; \
+    const char* closed = closedString(); \
+    if (c == closed[closed_match]) { \
+      closed_match++; \
+      held_at = millis(); \
+      if (closed[closed_match] == '\0') { \
+        DBG("### Transparent connection closed"); \
+        sock_connected = false; \
+        data_mode = false; \
+        closed_match = 0; \
+      } \
+      return; \
+    } \
+    owed_pos = 0; \
+    owed_len = closed_match; \
+    memcpy(owed, closed, closed_match); \
+    if (c == closed[0]) { \
+      closed_match = 1; \
+      held_at = millis(); \
+    } else { \
+      closed_match = 0; \
+      owed[owed_len++] = c; \
+    } \
+  } \
+  \
+  /* A partial match that went quiet was payload after all */ \
+  void releaseHeld() { \
+    if (closed_match && owed_pos == owed_len && \
+        at->stream.available() <= 0 && \
+        millis() - held_at >= TINY_GSM_TRANSPARENT_HOLD_MS) { \
+      owed_pos = 0; \
+      owed_len = closed_match; \
+      memcpy(owed, closedString(), closed_match); \
+      closed_match = 0; \
+    } \
+  } \
+  \
+  modemClass*     at; \
+  uint8_t         mux; \
+  bool            sock_connected; \
+  bool            data_mode; \
+  bool            link_open; \
+  uint8_t         closed_match; \
+  uint32_t        held_at; \
+  uint8_t         owed[sizeof(GSM_NL closedText GSM_NL)]; \
+  uint8_t         owed_len; \
+  uint8_t         owed_pos; \
+};
 
 
 // Set baud rate via the V.25TER standard IPR command
 #define TINY_GSM_MODEM_SET_BAUD_IPR() \
   void setBaud(unsigned long baud) { \
     sendAT(GF("+IPR="), baud); \
+  } \
+  \
+  /* Fixes the modem at the rate it is answering at and saves it, so after \
+     power-on it talks at that rate instead of waiting to auto-baud */ \
+  bool pinBaud(unsigned long baud) { \
+    sendAT(GF("+IPR="), baud); \
+    if (waitResponse() != 1) { \
+      return false; \
+    } \
+    sendAT(GF("&W")); \
+    return waitResponse() == 1; \
   }
 
 
@@ -451,25 +1171,38 @@ String TinyGsmDecodeHex16bit(String &instr) {
 // to see if any data is avaiable
 #define TINY_GSM_MODEM_MAINTAIN_CHECK_SOCKS() \
   void maintain() { \
-    for (int mux = 0; mux < TINY_GSM_MUX_COUNT; mux++) { \
+    TINY_GSM_MODEM_AT_QUEUE_SETTLE() \
+    TinyGsmSockMask pending = sock_pending; \
+    sock_pending = 0; \
+    for (int mux = 0; pending; mux++, pending >>= 1) { \
       GsmClient* sock = sockets[mux]; \
-      if (sock && sock->got_data) { \
-        sock->got_data = false; \
+      if ((pending & 1) && sock) { \
         sock->sock_available = modemGetAvailable(mux); \
+        TINY_GSM_MODEM_POLL_RESULT(sock) \
       } \
     } \
-    while (stream.available()) { \
-      waitResponse(15, NULL, NULL); \
+    if (stream.available()) { \
+      drainUrcs(TINY_GSM_URC_DRAIN_MS); \
     } \
-  }
+    TINY_GSM_MODEM_TX_FLUSH_DUE() \
+  } \
+  \
+TINY_GSM_MODEM_URC_DRAIN() \
+  \
+  TinyGsmSockMask  sock_pending = 0; \
+  TinyGsmPollStats poll_stats = { 0, 0 };
 
 
 // Keeps listening for modem URC's - doesn't check socks because
 // modem has no internal fifo
 #define TINY_GSM_MODEM_MAINTAIN_LISTEN() \
   void maintain() { \
-    waitResponse(100, NULL, NULL); \
-  }
+    TINY_GSM_MODEM_AT_QUEUE_SETTLE() \
+    drainUrcs(100); \
+    TINY_GSM_MODEM_TX_FLUSH_DUE() \
+  } \
+  \
+TINY_GSM_MODEM_URC_DRAIN()
 
 
 // Asks for modem information via the V.25TER standard ATI command
@@ -538,10 +1271,54 @@ String TinyGsmDecodeHex16bit(String &instr) {
       return REG_UNKNOWN; \
     } \
     streamSkipUntil(','); /* Skip format (0) */ \
-    int status = stream.readStringUntil('\n').toInt(); \
+    int status = streamReadInt('\n'); \
     waitResponse(); \
-    return (RegStatus)status; \
-  }
+    reg_status = (RegStatus)status; \
+    return reg_status; \
+  } \
+  \
+  /* Turns on unsolicited registration reports, which waitResponse() then \
+     picks up whenever the modem is read */ \
+  bool enableRegistrationUrc() { \
+    sendAT(GF("+" #regCommand "=2")); \
+    if (waitResponse() != 1) { \
+      return false; \
+    } \
+    reg_urc_prefix = GF(GSM_NL "+" #regCommand ":"); \
+    if (!matcherReload()) { \
+      reg_urc_prefix = NULL; \
+      matcherReload(); \
+      return false; \
+    } \
+    return true; \
+  } \
+  \
+  /* Registration status as last reported, without asking the modem */ \
+  RegStatus lastRegistrationStatus() { \
+    return reg_status; \
+  } \
+  \
+  /* Asks once, then sleeps until a registration report says the modem is \
+     registered, rather than polling */ \
+  bool waitForRegistration(unsigned long timeout_ms = 60000L) { \
+    if (!reg_urc_prefix && !enableRegistrationUrc()) { \
+      return waitForNetwork(timeout_ms); \
+    } \
+    getRegistrationStatus(); \
+    for (unsigned long start = millis(); ; ) { \
+      if (reg_status == REG_OK_HOME || reg_status == REG_OK_ROAMING) { \
+        return true; \
+      } \
+      if (millis() - start >= timeout_ms) { \
+        return false; \
+      } \
+      if (stream.available()) { \
+        waitResponse(TINY_GSM_URC_DRAIN_MS, NULL, NULL); \
+      } else { \
+        delay(1); \
+      } \
+    } \
+  }
 
 
 // Gets the current network operator via the 3GPP TS command AT+COPS
@@ -555,6 +1332,44 @@ String TinyGsmDecodeHex16bit(String &instr) {
     String res = stream.readStringUntil('"'); \
     waitResponse(); \
     return res; \
+  } \
+  \
+  /* MCC and MNC of the current operator, e.g. "51010", which unlike the \
+     name can be handed back to selectOperator() */ \
+  String getOperatorNumeric() { \
+    sendAT(GF("+COPS=3,2")); \
+    if (waitResponse() != 1) { \
+      return ""; \
+    } \
+    String res = getOperator(); \
+    sendAT(GF("+COPS=3,0")); \
+    waitResponse(); \
+    return res; \
+  } \
+  \
+  /* Registers on the given operator, on access technology act if it isn't \
+     negative.  Manual/automatic mode lets the modem fall back by itself if \
+     the operator can't be found; if it hasn't answered within timeout_ms \
+     automatic selection is forced. */ \
+  bool selectOperator(const char* oper, unsigned long timeout_ms = 20000L, int8_t act = -1) { \
+    if (act >= 0) { \
+      sendAT(GF("+COPS=4,2,\""), oper, GF("\","), act); \
+    } else { \
+      sendAT(GF("+COPS=4,2,\""), oper, '"'); \
+    } \
+    if (waitResponse(timeout_ms) == 1) { \
+      return true; \
+    } \
+    selectOperatorAuto(); \
+    return false; \
+  } \
+  \
+  /* Back to automatic selection, which a manual one leaves behind even \
+     once registered; the modem stays on its current operator while that \
+     can be found */ \
+  bool selectOperatorAuto() { \
+    sendAT(GF("+COPS=0")); \
+    return waitResponse(10000L) == 1; \
   }
 
 
@@ -578,7 +1393,7 @@ String TinyGsmDecodeHex16bit(String &instr) {
     if (waitResponse(GF(GSM_NL "+CGATT:")) != 1) { \
       return false; \
     } \
-    int res = stream.readStringUntil('\n').toInt(); \
+    int res = streamReadInt('\n'); \
     waitResponse(); \
     if (res != 1) \
       return false; \
@@ -587,6 +1402,30 @@ String TinyGsmDecodeHex16bit(String &instr) {
   }
 
 
+// Resolves host names by the modem's own DNS client, AT+CDNSGIP.  The answer
+// comes as a URC, so a lookup can be started with dnsRequest() and picked up
+// later by an addUrcHandler() for GF(GSM_NL "+CDNSGIP:") while other commands
+// run, or waited for with dnsResolve().
+#define TINY_GSM_MODEM_DNS_CDNSGIP() \
+  bool dnsRequest(const char* host) { \
+    sendAT(GF("+CDNSGIP=\""), host, '"'); \
+    return waitResponse() == 1; \
+  } \
+  \
+  /* Returns 0.0.0.0 if the name could not be resolved */ \
+  IPAddress dnsResolve(const char* host, unsigned long timeout_ms = 10000L) { \
+    if (!dnsRequest(host)) { \
+      return IPAddress(0,0,0,0); \
+    } \
+    if (waitResponse(timeout_ms, GF(GSM_NL "+CDNSGIP:")) != 1) { \
+      return IPAddress(0,0,0,0); \
+    } \
+    char args[TINY_GSM_URC_ARGS]; \
+    streamReadToken(args, sizeof(args), '\n'); \
+    return TinyGsmParseDnsResult(args); \
+  }
+
+
 // Gets signal quality report according to 3GPP TS command AT+CSQ
 #define TINY_GSM_MODEM_GET_CSQ() \
   int16_t getSignalQuality() { \
@@ -594,38 +1433,222 @@ String TinyGsmDecodeHex16bit(String &instr) {
     if (waitResponse(GF(GSM_NL "+CSQ:")) != 1) { \
       return 99; \
     } \
-    int res = stream.readStringUntil(',').toInt(); \
+    int res = streamReadInt(','); \
     waitResponse(); \
     return res; \
   }
 
 
-// Yields up to a time-out period and then reads a character from the stream into the mux FIFO
-// TODO:  Do we need to wait two _timeout periods for no character return?  Will wait once in the first
-// "while !stream.available()" and then will wait again in the stream.read() function.
-#define TINY_GSM_MODEM_STREAM_TO_MUX_FIFO_WITH_DOUBLE_TIMEOUT \
-  uint32_t startMillis = millis(); \
-  while (!stream.available() && (millis() - startMillis < sockets[mux]->_timeout)) { TINY_GSM_YIELD(); } \
-  char c = stream.read(); \
-  sockets[mux]->rx.put(c);
+// Moves len bytes from the stream into a FIFO in contiguous spans using
+// readBytes, instead of one available()/read() pair per byte.
+// The deadline is re-armed whenever data arrives, so a slow UART doesn't cut
+// a long payload short.  Bytes that don't fit in the FIFO are still consumed
+// (and dropped) to keep the stream in sync with the modem's framing.
+// Returns the number of bytes consumed from the stream.
+template<class S, class F>
+size_t TinyGsmStreamToFifo(S& stream, F& fifo, size_t len, uint32_t timeout_ms)
+{
+  size_t done = 0;
+  uint32_t startMillis = millis();
+  while (done < len) {
+    int avail = stream.available();
+    if (avail <= 0) {
+      if (millis() - startMillis >= timeout_ms) break;
+      TINY_GSM_YIELD();
+      continue;
+    }
+    size_t chunk = TinyGsmMin(len - done, (size_t)avail);
+    uint8_t* span;
+    size_t room = fifo.writeSpan(&span);
+    if (room) {
+      chunk = TinyGsmMin(chunk, room);
+      chunk = stream.readBytes((char*)span, chunk);
+      fifo.written(chunk);
+    } else {
+      uint8_t scratch[16];
+      chunk = TinyGsmMin(chunk, sizeof(scratch));
+      chunk = stream.readBytes((char*)scratch, chunk);
+    }
+    done += chunk;
+    startMillis = millis();
+  }
+  return done;
+}
+
+
+// Same as TinyGsmStreamToFifo, but the stream carries len bytes as 2*len
+// hex digits (TINY_GSM_USE_HEX); digits are read in blocks and decoded
+// straight into the FIFO with TinyGsmDecodeHexBlock.
+template<class S, class F>
+size_t TinyGsmStreamHexToFifo(S& stream, F& fifo, size_t len, uint32_t timeout_ms)
+{
+  char hex[64];
+  size_t done = 0;
+  uint32_t startMillis = millis();
+  while (done < len) {
+    int avail = stream.available();
+    if (avail < 2) {
+      if (millis() - startMillis >= timeout_ms) break;
+      TINY_GSM_YIELD();
+      continue;
+    }
+    size_t chunk = TinyGsmMin(len - done, (size_t)avail / 2);
+    chunk = TinyGsmMin(chunk, sizeof(hex) / 2);
+    uint8_t* span;
+    size_t room = fifo.writeSpan(&span);
+    if (room) {
+      chunk = TinyGsmMin(chunk, room);
+    }
+    chunk = stream.readBytes(hex, 2 * chunk) / 2;
+    if (room) {
+      fifo.written(TinyGsmDecodeHexBlock(hex, span, chunk));
+    }
+    done += chunk;
+    startMillis = millis();
+  }
+  return done;
+}
+
+
+// Drops n bytes from the stream, such as a payload for a socket that is
+// gone, so the AT framing after it stays in sync
+template<class S>
+size_t TinyGsmStreamSkip(S& stream, size_t n, uint32_t timeout_ms)
+{
+  size_t done = 0;
+  uint32_t startMillis = millis();
+  while (done < n) {
+    if (stream.available() <= 0) {
+      if (millis() - startMillis >= timeout_ms) break;
+      TINY_GSM_YIELD();
+      continue;
+    }
+    stream.read();
+    done++;
+    startMillis = millis();
+  }
+  return done;
+}
+
+
+#ifdef TINY_GSM_USE_HEX
+  #define TINY_GSM_CIPRXGET_MODE "3,"
+  #define TINY_GSM_STREAM_PAYLOAD_TO_FIFO TinyGsmStreamHexToFifo
+  #define TINY_GSM_PAYLOAD_CHARS 2
+#else
+  #define TINY_GSM_CIPRXGET_MODE "2,"
+  #define TINY_GSM_STREAM_PAYLOAD_TO_FIFO TinyGsmStreamToFifo
+  #define TINY_GSM_PAYLOAD_CHARS 1
+#endif
+
+// Reads data buffered in the modem via AT+CIPRXGET=2 (or =3 for hex mode)
+#define TINY_GSM_MODEM_READ_CIPRXGET() \
+  size_t modemRead(size_t size, uint8_t mux) { \
+    /* A late read-ahead reply may fill the FIFO first */ \
+    TINY_GSM_MODEM_READ_AHEAD_SETTLE() \
+    size = TinyGsmMin(size, (size_t)sockets[mux]->rx.free()); \
+    if (!size) { \
+      return 0; \
+    } \
+    sendAT(GF("+CIPRXGET=" TINY_GSM_CIPRXGET_MODE), mux, ',', (uint16_t)size); \
+    if (waitResponse(GF("+CIPRXGET:")) != 1) { \
+      return 0; \
+    } \
+    modemCipRxGetMode(); /* Rx mode 2/normal or 3/HEX */ \
+    return modemReadPayload(); \
+  } \
+  \
+  /* Parses the rest of a "+CIPRXGET: 2," reply, moves the data into the
+  socket fifo and eats the final OK */ \
+  size_t modemReadPayload() { \
+    int mux = streamReadInt(','); \
+    int len_requested = streamReadInt(','); \
+    /*  ^^ Requested number of data bytes (1-1460 bytes)to be read */ \
+    int len_confirmed = streamReadInt('\n'); \
+    /* ^^ The data length which not read in the buffer */ \
+    TINY_GSM_MODEM_READ_AHEAD_DONE() \
+    if (mux < 0 || mux >= TINY_GSM_MUX_COUNT || !sockets[mux] || len_requested < 0) { \
+      TinyGsmStreamSkip(stream, TinyGsmMax(len_requested, 0) * TINY_GSM_PAYLOAD_CHARS, 1000L); \
+      waitResponse(); \
+      return 0; \
+    } \
+    size_t moved = TINY_GSM_STREAM_PAYLOAD_TO_FIFO(stream, sockets[mux]->rx, len_requested, sockets[mux]->_timeout); \
+    TINY_GSM_AT_STATS_BYTES(0, moved) \
+    DBG_TRACE(GF("### READ:"), len_requested, GF("from"), mux); \
+    sockets[mux]->sock_available = len_confirmed; \
+    waitResponse(); \
+    return len_requested; \
+  } \
+  TINY_GSM_MODEM_READ_AHEAD_CIPRXGET()
+
+#if defined(TINY_GSM_READ_AHEAD)
+  #define TINY_GSM_MODEM_READ_AHEAD_DONE() read_ahead_mux = -1;
+  // Keeps at most one CIPRXGET in flight while the application consumes the
+  // socket fifo.  The reply is picked up by waitResponse (which then returns
+  // early), and sendAT waits for it before sending anything else.
+  #define TINY_GSM_MODEM_READ_AHEAD_CIPRXGET() \
+  void modemReadAhead(size_t size, uint8_t mux) { \
+    if (read_ahead_mux >= 0 || size == 0) { \
+      return; \
+    } \
+    sendAT(GF("+CIPRXGET=" TINY_GSM_CIPRXGET_MODE), mux, ',', (uint16_t)size); \
+    read_ahead_mux = mux; \
+  } \
+  \
+  /* An ERROR means the modem refused the request.  If the reply is late, \
+     the request stays pending: whenever the reply turns up it is still \
+     read by its length, and never taken for AT text. */ \
+  void modemReadAheadComplete(uint32_t timeout_ms = 1000L) { \
+    for (uint32_t start = millis(); read_ahead_mux >= 0 && millis() - start < timeout_ms; ) { \
+      if (waitResponse(timeout_ms, GFP(GSM_ERROR), NULL) == 1) { \
+        read_ahead_mux = -1; \
+      } \
+    } \
+  } \
+  \
+  /* Reads the mode of a +CIPRXGET reply, after the reply to a read-ahead \
+     still pending, which can come in ahead of the one asked for */ \
+  int modemCipRxGetMode() { \
+    int mode = streamReadInt(','); \
+    while ((mode == 2 || mode == 3) && read_ahead_mux >= 0) { \
+      modemReadPayload(); \
+      if (waitResponse(GF("+CIPRXGET:")) != 1) { \
+        return -1; \
+      } \
+      mode = streamReadInt(','); \
+    } \
+    return mode; \
+  } \
+  \
+  int8_t read_ahead_mux = -1;
+#else
+  #define TINY_GSM_MODEM_READ_AHEAD_DONE()
+  #define TINY_GSM_MODEM_READ_AHEAD_CIPRXGET() \
+  int modemCipRxGetMode() { \
+    return streamReadInt(','); \
+  }
+#endif
 
 
 // Utility templates for writing/skipping characters on a stream
 #define TINY_GSM_MODEM_STREAM_UTILITIES() \
   template<typename T> \
-  void streamWrite(T last) { \
-    stream.print(last); \
+  size_t streamWrite(T last) { \
+    return stream.print(last); \
   } \
   \
   template<typename T, typename... Args> \
-  void streamWrite(T head, Args... tail) { \
-    stream.print(head); \
-    streamWrite(tail...); \
+  size_t streamWrite(T head, Args... tail) { \
+    size_t n = stream.print(head); \
+    return n + streamWrite(tail...); \
   } \
   \
   template<typename... Args> \
   void sendAT(Args... cmd) { \
-    streamWrite("AT", cmd..., GSM_NL); \
+    TINY_GSM_MODEM_AT_QUEUE_SETTLE() \
+    TINY_GSM_MODEM_READ_AHEAD_SETTLE() \
+    size_t sent = streamWrite("AT", cmd..., GSM_NL); \
+    TINY_GSM_AT_STATS_BEGIN(sent, cmd...) \
     stream.flush(); \
     TINY_GSM_YIELD(); \
     /* DBG("### AT:", cmd...); */ \
@@ -642,7 +1665,648 @@ String TinyGsmDecodeHex16bit(String &instr) {
       } \
     } \
     return false; \
+  } \
+  \
+  /* Field readers for replies like "+CSQ: 21,99".  They parse straight off \
+     the stream, so unlike readStringUntil() they never touch the heap. */ \
+  \
+  /* Parses a field up to the delimiter the way String::toInt() would: \
+     leading blanks and a sign are accepted, parsing stops at the first \
+     non-digit, and the rest of the field is consumed with the delimiter */ \
+  int32_t streamReadInt(const char delim, const unsigned long timeout_ms = 1000L) { \
+    int32_t value = 0; \
+    bool neg = false, sign = false, started = false, done = false; \
+    unsigned long startMillis = millis(); \
+    while (millis() - startMillis < timeout_ms) { \
+      if (!stream.available()) { \
+        TINY_GSM_YIELD(); \
+        continue; \
+      } \
+      int c = stream.read(); \
+      if (c == delim) { \
+        break; \
+      } \
+      if (done) { \
+        continue; \
+      } \
+      if (c >= '0' && c <= '9') { \
+        value = value * 10 + (c - '0'); \
+        started = true; \
+      } else if (started || sign) { \
+        done = true; \
+      } else if (c == '-' || c == '+') { \
+        sign = true; \
+        neg = (c == '-'); \
+      } else if (c != ' ' && c != '\t' && c != '\r' && c != '\n') { \
+        done = true; \
+      } \
+    } \
+    return neg ? -value : value; \
+  } \
+  \
+  /* Copies a field up to the delimiter into buf, keeping at most size - 1 \
+     characters and always terminating it.  Returns the stored length. */ \
+  size_t streamReadToken(char* buf, size_t size, const char delim, \
+                         const unsigned long timeout_ms = 1000L) { \
+    size_t len = 0; \
+    unsigned long startMillis = millis(); \
+    while (millis() - startMillis < timeout_ms) { \
+      if (!stream.available()) { \
+        TINY_GSM_YIELD(); \
+        continue; \
+      } \
+      int c = stream.read(); \
+      if (c == delim) { \
+        break; \
+      } \
+      if (len + 1 < size) { \
+        buf[len++] = (char)c; \
+      } \
+    } \
+    if (size) { \
+      buf[len] = '\0'; \
+    } \
+    return len; \
+  } \
+  \
+  TINY_GSM_MODEM_AT_STATS()
+
+
+// Counts every heap allocation in the program, to check that the AT paths
+// stay off the heap: compare TinyGsmAllocCount before and after a command.
+// Needs the linker flags -Wl,--wrap=malloc -Wl,--wrap=realloc.
+#if defined(TINY_GSM_COUNT_ALLOCS)
+extern "C" {
+  void* __real_malloc(size_t size);
+  void* __real_realloc(void* ptr, size_t size);
+
+  __attribute__((weak)) volatile uint32_t TinyGsmAllocCount = 0;
+
+  __attribute__((weak, used)) void* __wrap_malloc(size_t size) {
+    TinyGsmAllocCount++;
+    return __real_malloc(size);
+  }
+
+  __attribute__((weak, used)) void* __wrap_realloc(void* ptr, size_t size) {
+    TinyGsmAllocCount++;
+    return __real_realloc(ptr, size);
+  }
+}
+#endif
+
+// Trie size for the waitResponse() matcher, shared by the driver's URCs,
+// the application's URC handlers and the expected responses.  Of it,
+// TINY_GSM_MATCH_EXPECT nodes are kept for the expected responses: a URC
+// handler that would leave less is refused.
+#ifndef TINY_GSM_MATCH_NODES
+  #define TINY_GSM_MATCH_NODES 192
+#endif
+
+#ifndef TINY_GSM_MATCH_EXPECT
+  #define TINY_GSM_MATCH_EXPECT 64
+#endif
+
+// Matcher ids 1-6 are the expected responses r1-r6, the driver's URCs are
+// numbered from here in the order urcPattern() lists them
+#define TINY_GSM_MATCH_URC 7
+
+// Cap on the scratch line behind waitResponse() calls that don't ask for
+// the response text
+#ifndef TINY_GSM_LINE_BUFFER
+  #define TINY_GSM_LINE_BUFFER 64
+#endif
+
+// Appends a received byte to the response text.  The modem's own scratch
+// line keeps its buffer from one command to the next and is capped by
+// dropping complete lines from the front, so once warmed up it never touches
+// the heap.  Text a caller asked for is kept whole.
+#define TINY_GSM_LINE_PUT(data, c) \
+  data += (char)(c); \
+  TINY_GSM_AT_STATS_RX() \
+  if (&data == &wait_line && data.length() >= TINY_GSM_LINE_BUFFER) { \
+    int nl = data.lastIndexOf('\n', data.length() - 2); \
+    data.remove(0, nl >= 0 ? nl + 1 : data.length() - TINY_GSM_LINE_BUFFER / 2); \
   }
 
+// Room for URC handlers added by the application, and for the text that
+// follows the prefix on the URC's line
+#ifndef TINY_GSM_URC_HANDLERS
+  #define TINY_GSM_URC_HANDLERS 4
+#endif
+
+#ifndef TINY_GSM_URC_ARGS
+  #define TINY_GSM_URC_ARGS 64
+#endif
+
+// Called with the rest of the URC's line (without the line break).  It runs
+// inside waitResponse(), so it must not send commands to the modem.
+typedef void (*TinyGsmUrcHandler)(const char* args, void* ctx);
+
+struct TinyGsmUrcEntry {
+  GsmConstStr       prefix;
+  TinyGsmUrcHandler handler;
+  void*             ctx;
+};
+
+// Per-command statistics, off unless TINY_GSM_AT_STATS gives the number of
+// distinct commands to track.  Commands are keyed by mnemonic: the text of
+// the first argument to sendAT() up to a comma or quote, keeping one
+// character after '=', so "+CIPRXGET=2," and "+CIPRXGET=4," are counted
+// apart.  A command's latency runs from sendAT() to the last expected
+// response its waitResponse() calls got, so "+CIPSEND=" includes the wait
+// for DATA ACCEPT.  A command whose first wait times out counts as a timeout.
+#ifndef TINY_GSM_AT_STATS_KEY
+  #define TINY_GSM_AT_STATS_KEY 14
+#endif
+
+// Bucket b holds latencies in [2^(b-1), 2^b) ms, bucket 0 is 0 ms and the
+// last one is open-ended
+#ifndef TINY_GSM_AT_STATS_BUCKETS
+  #define TINY_GSM_AT_STATS_BUCKETS 14
+#endif
+
+struct TinyGsmAtStat {
+  char     key[TINY_GSM_AT_STATS_KEY];
+  uint16_t count;
+  uint16_t timeouts;
+  uint32_t latency_total;
+  uint32_t latency_max;
+  uint32_t bytes_tx;
+  uint32_t bytes_rx;
+  uint16_t hist[TINY_GSM_AT_STATS_BUCKETS];
+};
+
+#if defined(TINY_GSM_AT_STATS)
+#define TINY_GSM_AT_STATS_BEGIN(sent, ...) atStatsBegin(sent, __VA_ARGS__);
+#define TINY_GSM_AT_STATS_RESULT(index) atStatsResult(index);
+// Payload moved outside waitResponse(), e.g. socket data
+#define TINY_GSM_AT_STATS_BYTES(tx, rx) atStatsBytes(tx, rx);
+#define TINY_GSM_AT_STATS_RX() \
+  if (at_stat_cur >= 0) { \
+    at_stats[at_stat_cur].bytes_rx++; \
+  }
+
+#if defined(__AVR__)
+  // Commands built in RAM, as opposed to GF() strings in flash
+  #define TINY_GSM_AT_STATS_RAM_KEY() \
+  void atStatsKeyOf(char* key, const char* cmd) { \
+    atStatsKeyCopy(key, cmd, false); \
+  }
+#else
+  #define TINY_GSM_AT_STATS_RAM_KEY()
+#endif
+
+#define TINY_GSM_MODEM_AT_STATS() \
+  uint8_t atStatsCount() { \
+    return at_stats_count; \
+  } \
+  \
+  const TinyGsmAtStat& atStat(uint8_t i) { \
+    return at_stats[i]; \
+  } \
+  \
+  void atStatsClear() { \
+    at_stats_count = 0; \
+    at_stats_dropped = 0; \
+    at_stat_cur = -1; \
+  } \
+  \
+  /* One line per command, latencies in ms: \
+     AT+CIPRXGET=2 n=120 to=0 avg=35 max=210 tx=2400 rx=150000 h=0,0,3,10,57 \
+     h lists the histogram buckets up to the last non-empty one */ \
+  void atStatsDump(Print& out) { \
+    atStatsClose(); \
+    for (uint8_t i = 0; i < at_stats_count; i++) { \
+      const TinyGsmAtStat& st = at_stats[i]; \
+      uint8_t last = TINY_GSM_AT_STATS_BUCKETS; \
+      while (last > 1 && !st.hist[last - 1]) { \
+        last--; \
+      } \
+      out.print(GF("AT")); \
+      out.print(st.key); \
+      out.print(GF(" n=")); \
+      out.print(st.count); \
+      out.print(GF(" to=")); \
+      out.print(st.timeouts); \
+      out.print(GF(" avg=")); \
+      out.print(st.count ? st.latency_total / st.count : 0); \
+      out.print(GF(" max=")); \
+      out.print(st.latency_max); \
+      out.print(GF(" tx=")); \
+      out.print(st.bytes_tx); \
+      out.print(GF(" rx=")); \
+      out.print(st.bytes_rx); \
+      out.print(GF(" h=")); \
+      for (uint8_t b = 0; b < last; b++) { \
+        if (b) out.print(','); \
+        out.print(st.hist[b]); \
+      } \
+      out.println(); \
+    } \
+    if (at_stats_dropped) { \
+      out.print(GF("# untracked ")); \
+      out.println(at_stats_dropped); \
+    } \
+  } \
+  \
+  template<typename... Args> \
+  void atStatsBegin(size_t sent, Args... cmd) { \
+    atStatsClose(); \
+    char key[TINY_GSM_AT_STATS_KEY]; \
+    atStatsKey(key, cmd...); \
+    uint8_t i = 0; \
+    while (i < at_stats_count && strcmp(at_stats[i].key, key)) { \
+      i++; \
+    } \
+    if (i == at_stats_count) { \
+      if (i >= TINY_GSM_AT_STATS) { \
+        at_stats_dropped++; \
+        return; \
+      } \
+      memset(&at_stats[i], 0, sizeof(at_stats[i])); \
+      strcpy(at_stats[i].key, key); \
+      at_stats_count++; \
+    } \
+    at_stats[i].bytes_tx += sent; \
+    at_stat_cur = i; \
+    at_stat_start = millis(); \
+    at_stat_answered = false; \
+  } \
+  \
+  void atStatsResult(uint8_t index) { \
+    if (at_stat_cur < 0 || (match_resume && !index)) { \
+      return; \
+    } \
+    if (index) { \
+      at_stat_end = millis(); \
+      at_stat_answered = true; \
+    } else if (!at_stat_answered) { \
+      at_stats[at_stat_cur].timeouts++; \
+      at_stat_cur = -1; \
+    } else { \
+      atStatsClose(); \
+    } \
+  } \
+  \
+  void atStatsBytes(size_t tx, size_t rx) { \
+    if (at_stat_cur >= 0) { \
+      at_stats[at_stat_cur].bytes_tx += tx; \
+      at_stats[at_stat_cur].bytes_rx += rx; \
+    } \
+  } \
+  \
+  void atStatsClose() { \
+    if (at_stat_cur >= 0 && at_stat_answered) { \
+      TinyGsmAtStat& st = at_stats[at_stat_cur]; \
+      uint32_t latency = at_stat_end - at_stat_start; \
+      uint8_t b = 0; \
+      for (uint32_t ms = latency; ms && b < TINY_GSM_AT_STATS_BUCKETS - 1; ms >>= 1) { \
+        b++; \
+      } \
+      st.hist[b]++; \
+      st.count++; \
+      st.latency_total += latency; \
+      if (latency > st.latency_max) { \
+        st.latency_max = latency; \
+      } \
+    } \
+    at_stat_cur = -1; \
+  } \
+  \
+  void atStatsKey(char* key) { \
+    key[0] = '\0'; \
+  } \
+  \
+  template<typename T, typename... Args> \
+  void atStatsKey(char* key, T head, Args...) { \
+    atStatsKeyOf(key, head); \
+  } \
+  \
+  void atStatsKeyOf(char* key, GsmConstStr cmd) { \
+    atStatsKeyCopy(key, reinterpret_cast<const char*>(cmd), true); \
+  } \
+  \
+  TINY_GSM_AT_STATS_RAM_KEY() \
+  \
+  template<typename T> \
+  void atStatsKeyOf(char* key, const T&) { \
+    key[0] = '\0'; \
+  } \
+  \
+  void atStatsKeyCopy(char* key, const char* p, bool flash) { \
+    uint8_t n = 0; \
+    bool eq = false; \
+    for (char c; n + 1 < TINY_GSM_AT_STATS_KEY; p++) { \
+      c = flash ? TINY_GSM_MATCH_CHAR(p) : *p; \
+      if (!c || c == ',' || c == '"') { \
+        break; \
+      } \
+      key[n++] = c; \
+      if (eq) { \
+        break; \
+      } \
+      eq = (c == '='); \
+    } \
+    key[n] = '\0'; \
+  } \
+  \
+  TinyGsmAtStat at_stats[TINY_GSM_AT_STATS]; \
+  uint8_t       at_stats_count = 0; \
+  uint16_t      at_stats_dropped = 0; \
+  int8_t        at_stat_cur = -1; \
+  bool          at_stat_answered = false; \
+  uint32_t      at_stat_start = 0; \
+  uint32_t      at_stat_end = 0;
+#else
+  #define TINY_GSM_AT_STATS_BEGIN(sent, ...) (void)(sent);
+  #define TINY_GSM_AT_STATS_RESULT(index)
+  #define TINY_GSM_AT_STATS_BYTES(tx, rx) (void)(tx); (void)(rx);
+  #define TINY_GSM_AT_STATS_RX()
+  #define TINY_GSM_MODEM_AT_STATS()
+#endif
+
+// Pipelined AT command queue, off unless TINY_GSM_AT_QUEUE gives its depth.
+// Commands are queued with a completion callback and atPoll() sends each one
+// the moment the previous one has its final result, so a batch like CSQ,
+// CREG? and a CIPRXGET=4 per socket runs back to back without the caller
+// waiting on any of them.  The modem still takes one command at a time; the
+// head of the queue owns the expected responses and URCs are routed by
+// waitResponse() as usual.
+#ifndef TINY_GSM_AT_QUEUE
+  #define TINY_GSM_AT_QUEUE 0
+#endif
+
+#ifndef TINY_GSM_AT_QUEUE_CMD
+  #define TINY_GSM_AT_QUEUE_CMD 32
+#endif
+
+// index is the expected response that arrived (1-3), or 0 on timeout.
+// latency_ms runs from the moment the command was sent.
+typedef void (*TinyGsmAtCallback)(uint8_t index, const String& response,
+                                  uint32_t latency_ms, void* ctx);
+
+struct TinyGsmAtQueueStats {
+  uint32_t completed;
+  uint32_t timeouts;
+  uint32_t latency_total;
+  uint32_t latency_max;
+  uint8_t  depth_max;
+};
+
+#if TINY_GSM_AT_QUEUE > 0
+// Synchronous commands wait for the queue to drain, so they never see the
+// responses of a queued command
+#define TINY_GSM_MODEM_AT_QUEUE_SETTLE() atQueueFlush();
+
+#define TINY_GSM_MODEM_AT_QUEUE() \
+  /* Queues "AT" + cmd; returns false if the queue is full or the command \
+     doesn't fit.  Nothing is read or sent until atPoll(). */ \
+  bool atEnqueue(const char* cmd, TinyGsmAtCallback callback, void* ctx = NULL, \
+                 uint32_t timeout_ms = 1000L, GsmConstStr r1 = GFP(GSM_OK), \
+                 GsmConstStr r2 = GFP(GSM_ERROR), GsmConstStr r3 = NULL) { \
+    if (at_queue_count >= TINY_GSM_AT_QUEUE || \
+        strlen(cmd) >= TINY_GSM_AT_QUEUE_CMD) { \
+      return false; \
+    } \
+    AtQueueEntry& e = at_queue[(at_queue_head + at_queue_count) % TINY_GSM_AT_QUEUE]; \
+    strcpy(e.cmd, cmd); \
+    e.callback = callback; \
+    e.ctx = ctx; \
+    e.timeout_ms = timeout_ms; \
+    e.r1 = r1; \
+    e.r2 = r2; \
+    e.r3 = r3; \
+    if (++at_queue_count > at_queue_stats.depth_max) { \
+      at_queue_stats.depth_max = at_queue_count; \
+    } \
+    return true; \
+  } \
+  \
+  /* Never blocks: takes whatever the modem has sent so far, completes the \
+     head command if its final result is in, and sends the next one */ \
+  void atPoll() { \
+    while (at_queue_count) { \
+      AtQueueEntry& e = at_queue[at_queue_head]; \
+      if (!at_queue_busy) { \
+        TINY_GSM_MODEM_READ_AHEAD_SETTLE() \
+        size_t sent = streamWrite("AT", e.cmd, GSM_NL); \
+        TINY_GSM_AT_STATS_BEGIN(sent, (const char*)e.cmd) \
+        stream.flush(); \
+        matcherExpect(e.r1, e.r2, e.r3, NULL, NULL); \
+        at_queue_text = ""; \
+        at_queue_start = millis(); \
+        at_queue_busy = true; \
+      } \
+      match_resume = true; \
+      uint8_t index = waitResponse(0, at_queue_text, e.r1, e.r2, e.r3); \
+      match_resume = false; \
+      uint32_t latency = millis() - at_queue_start; \
+      if (!index && latency < e.timeout_ms) { \
+        return; \
+      } \
+      if (index) { \
+        at_queue_stats.completed++; \
+        at_queue_stats.latency_total += latency; \
+        if (latency > at_queue_stats.latency_max) { \
+          at_queue_stats.latency_max = latency; \
+        } \
+      } else { \
+        at_queue_stats.timeouts++; \
+        TINY_GSM_AT_STATS_RESULT(0) \
+      } \
+      TinyGsmAtCallback callback = e.callback; \
+      void* ctx = e.ctx; \
+      at_queue_head = (at_queue_head + 1) % TINY_GSM_AT_QUEUE; \
+      at_queue_count--; \
+      at_queue_busy = false; \
+      /* Popped first, so the callback may queue a follow-up command; it \
+         gets its own copy of the text in case it sends one right away */ \
+      if (callback) { \
+        String response = at_queue_text; \
+        callback(index, response, latency, ctx); \
+      } \
+    } \
+  } \
+  \
+  void atQueueFlush() { \
+    while (at_queue_count) { \
+      atPoll(); \
+      TINY_GSM_YIELD(); \
+    } \
+  } \
+  \
+  /* Commands queued or in flight */ \
+  uint8_t atQueueDepth() { \
+    return at_queue_count; \
+  } \
+  \
+  /* Average latency is latency_total / completed */ \
+  const TinyGsmAtQueueStats& atQueueStats() { \
+    return at_queue_stats; \
+  } \
+  \
+  struct AtQueueEntry { \
+    char              cmd[TINY_GSM_AT_QUEUE_CMD]; \
+    TinyGsmAtCallback callback; \
+    void*             ctx; \
+    uint32_t          timeout_ms; \
+    GsmConstStr       r1, r2, r3; \
+  }; \
+  AtQueueEntry at_queue[TINY_GSM_AT_QUEUE]; \
+  uint8_t      at_queue_head = 0; \
+  uint8_t      at_queue_count = 0; \
+  uint32_t     at_queue_start = 0; \
+  bool         at_queue_busy = false; \
+  String       at_queue_text; \
+  TinyGsmAtQueueStats at_queue_stats = { 0, 0, 0, 0, 0 };
+#else
+  #define TINY_GSM_MODEM_AT_QUEUE_SETTLE()
+  #define TINY_GSM_MODEM_AT_QUEUE()
+#endif
+
+// Loads the matcher with the expected responses, the driver's URCs and then
+// the application's URC handlers.  The trie is only rebuilt when one of
+// those changes, which for most commands (OK/ERROR) they don't.  Expected
+// responses are compared by pointer and by the text's checksum, since a
+// RAM buffer may be passed again with other contents.
+// Application URCs are dispatched by matcher id, straight into the table.
+#define TINY_GSM_MODEM_MATCHER() \
+  void matcherExpect(GsmConstStr r1, GsmConstStr r2, GsmConstStr r3, \
+                     GsmConstStr r4, GsmConstStr r5, GsmConstStr r6 = NULL) { \
+    uint32_t sum = matcher.digest(r1); \
+    sum = matcher.digest(r2, sum); \
+    sum = matcher.digest(r3, sum); \
+    sum = matcher.digest(r4, sum); \
+    sum = matcher.digest(r5, sum); \
+    sum = matcher.digest(r6, sum); \
+    if (match_loaded && r1 == match_expect[0] && r2 == match_expect[1] && \
+        r3 == match_expect[2] && r4 == match_expect[3] && \
+        r5 == match_expect[4] && r6 == match_expect[5] && \
+        sum == match_sum) { \
+      if (!match_resume) { \
+        matcher.reset(); \
+      } \
+      return; \
+    } \
+    match_expect[0] = r1; \
+    match_expect[1] = r2; \
+    match_expect[2] = r3; \
+    match_expect[3] = r4; \
+    match_expect[4] = r5; \
+    match_expect[5] = r6; \
+    match_sum = sum; \
+    if (!matcherLoad(true)) { \
+      DBG("### Expected responses don't fit, raise TINY_GSM_MATCH_EXPECT"); \
+    } \
+  } \
+  \
+  /* The URCs go in first, so they are never the ones left out; \
+     addUrcHandler() has made sure they leave TINY_GSM_MATCH_EXPECT nodes. \
+     Ids stay in priority order: expected responses first. */ \
+  bool matcherLoad(bool expect) { \
+    matcher.clear(); \
+    bool ok = true; \
+    GsmConstStr urc; \
+    uint8_t id = TINY_GSM_MATCH_URC; \
+    for (; (urc = urcPattern(id)) != NULL; id++) { \
+      ok &= matcher.add(urc, id) != 0; \
+    } \
+    match_app_base = id; \
+    if (reg_urc_prefix) { \
+      ok &= matcher.add(reg_urc_prefix, id++) != 0; \
+    } \
+    for (uint8_t i = 0; i < urc_app_count; i++) { \
+      ok &= matcher.add(urc_app[i].prefix, id++) != 0; \
+    } \
+    if (!expect) { \
+      return ok && matcher.nodes() + TINY_GSM_MATCH_EXPECT <= TINY_GSM_MATCH_NODES; \
+    } \
+    for (uint8_t i = 0; i < 6; i++) { \
+      ok &= matcher.add(match_expect[i], i + 1) != 0; \
+    } \
+    matcher.build(); \
+    match_loaded = true; \
+    return ok; \
+  } \
+  \
+  /* Reloads the matcher for the URC handlers, keeping the responses \
+     being waited for; false if the URCs leave too little room */ \
+  bool matcherReload() { \
+    bool loaded = match_loaded; \
+    match_loaded = false; \
+    bool fits = matcherLoad(false); \
+    if (loaded) { \
+      matcherLoad(true); \
+    } \
+    return fits; \
+  } \
+  \
+  /* Lets the application react to a URC, e.g. GF("+CMTI:") or \
+     GF(GSM_NL "RDY"), whenever the modem is being read */ \
+  bool addUrcHandler(GsmConstStr prefix, TinyGsmUrcHandler handler, void* ctx = NULL) { \
+    if (!prefix || !handler || urc_app_count >= TINY_GSM_URC_HANDLERS) { \
+      return false; \
+    } \
+    urc_app[urc_app_count].prefix = prefix; \
+    urc_app[urc_app_count].handler = handler; \
+    urc_app[urc_app_count].ctx = ctx; \
+    urc_app_count++; \
+    if (!matcherReload()) { \
+      DBG("### No room for URC handler, raise TINY_GSM_MATCH_NODES"); \
+      urc_app_count--; \
+      matcherReload(); \
+      return false; \
+    } \
+    return true; \
+  } \
+  \
+  bool removeUrcHandler(GsmConstStr prefix) { \
+    for (uint8_t i = 0; i < urc_app_count; i++) { \
+      if (urc_app[i].prefix == prefix) { \
+        for (urc_app_count--; i < urc_app_count; i++) { \
+          urc_app[i] = urc_app[i + 1]; \
+        } \
+        matcherReload(); \
+        return true; \
+      } \
+    } \
+    return false; \
+  } \
+  \
+  /* Handles every hit from match_app_base up: the registration report \
+     first, if enabled, then the application's URCs */ \
+  void urcDispatch(uint8_t hit) { \
+    uint8_t i = hit - match_app_base; \
+    char args[TINY_GSM_URC_ARGS]; \
+    size_t len = streamReadToken(args, sizeof(args), '\n'); \
+    if (len && args[len - 1] == '\r') { \
+      args[len - 1] = '\0'; \
+    } \
+    if (reg_urc_prefix) { \
+      if (i == 0) { \
+        /* "+CREG: <stat>[,<lac>,<ci>]" */ \
+        reg_status = (RegStatus)atoi(args); \
+        DBG("### Registration:", reg_status); \
+        return; \
+      } \
+      i--; \
+    } \
+    const TinyGsmUrcEntry& e = urc_app[i]; \
+    e.handler(args, e.ctx); \
+  } \
+  \
+  TinyGsmMatcher<TINY_GSM_MATCH_NODES> matcher; \
+  TinyGsmUrcEntry urc_app[TINY_GSM_URC_HANDLERS]; \
+  uint8_t     urc_app_count = 0; \
+  uint8_t     match_app_base = TINY_GSM_MATCH_URC; \
+  GsmConstStr match_expect[6]; \
+  uint32_t    match_sum = 0; \
+  bool        match_loaded = false; \
+  bool        match_resume = false; \
+  String      wait_line; \
+  GsmConstStr reg_urc_prefix = NULL; \
+  RegStatus   reg_status = REG_UNKNOWN; \
+  \
+  TINY_GSM_MODEM_AT_QUEUE()
 
 #endif
@@ -69,6 +69,21 @@ public:
         return n - c;
     }
 
+    // Contiguous free space starting at the write index, so a producer
+    // can fill the buffer in place and then commit with written()
+    int writeSpan(T** p)
+    {
+        int f = free();
+        int m = N - _w;
+        *p = &_b[_w];
+        return (f < m) ? f : m;
+    }
+
+    void written(int n)
+    {
+        _w = _inc(_w, n);
+    }
+
     // reading thread/context API
     // --------------------------------------------------------
 
@@ -95,6 +110,29 @@ public:
         return true;
     }
 
+    bool peek(T* p)
+    {
+        if (_r == _w) // !readable()
+            return false;
+        *p = _b[_r];
+        return true;
+    }
+
+    // Contiguous data starting at the read index, so a consumer can scan
+    // it in place and then drop what it used with consumed()
+    int readSpan(T** p)
+    {
+        int s = size();
+        int m = N - _r;
+        *p = &_b[_r];
+        return (s < m) ? s : m;
+    }
+
+    void consumed(int n)
+    {
+        _r = _inc(_r, n);
+    }
+
     int get(T* p, int n, bool t = false)
     {
         int c = n;
@@ -0,0 +1,394 @@
+/**
+ * @file       TinyGsmLog.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Nov 2016
+ */
+
+#ifndef TinyGsmLog_h
+#define TinyGsmLog_h
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+// Deferred debug output, used by DBG() when TINY_GSM_DEBUG_DEFERRED gives
+// the size of the log ring in bytes (a power of two).  DBG() only packs its
+// arguments into a binary record and returns; TinyGsmLogDrain() prints the
+// records later, in the same format as direct output.  On the ESP32,
+// TinyGsmLogStartTask() drains from a low priority task on the other core.
+//
+// The ring takes one writer and one reader: log from one task only.
+// Records that don't fit are dropped and counted.
+//
+// Each record is its length, the time in ms, then one entry per argument:
+//   'p' + pointer   a flash string, from F() or GF(), which lives as long as
+//                   the program
+//   's' + n + text  any other string, or anything else printed as text,
+//                   copied: a char array may be gone or changed by the time
+//                   the record is printed
+//   'i'/'u' + 4     signed/unsigned integer
+//   'c' + 1         character
+//   'f' + 4         floating point
+//   'a' + 4         IPv4 address, printed dotted
+
+#ifndef TINY_GSM_LOG_RECORD
+  #define TINY_GSM_LOG_RECORD 128
+#endif
+
+// Collects the text of an argument that has to be copied
+class TinyGsmLogText : public Print
+{
+public:
+    TinyGsmLogText(uint8_t* buf, uint8_t size) : _buf(buf), _size(size), _len(0) {}
+
+    virtual size_t write(uint8_t c)
+    {
+        if (_len >= _size)
+            return 0;
+        _buf[_len++] = c;
+        return 1;
+    }
+
+    uint8_t length() const
+    {
+        return _len;
+    }
+
+private:
+    uint8_t* _buf;
+    uint8_t  _size;
+    uint8_t  _len;
+};
+
+class TinyGsmLogRecord
+{
+public:
+    TinyGsmLogRecord()
+    {
+        uint32_t ms = millis();
+        _len = 1;
+        _full = false;
+        memcpy(_b + _len, &ms, sizeof(ms));
+        _len += sizeof(ms);
+    }
+
+    template <size_t N>
+    void add(const char (&s)[N])
+    {
+        _text(s);
+    }
+
+    template <size_t N>
+    void add(char (&s)[N])
+    {
+        _text(s);
+    }
+
+    template <class T>
+    void add(const T& v)
+    {
+        _put(v);
+    }
+
+    const uint8_t* data()
+    {
+        _b[0] = _len;
+        return _b;
+    }
+
+    uint8_t length() const
+    {
+        return _len;
+    }
+
+private:
+    void _put(const char* s)                 { _text(s); }
+    void _put(char* s)                       { _text(s); }
+    void _put(const __FlashStringHelper* s)  { _ptr('p', s); }
+    void _put(char c)                        { _entry('c', &c, 1); }
+    void _put(bool v)                        { _int('u', v); }
+    void _put(signed char v)                 { _int('i', v); }
+    void _put(unsigned char v)               { _int('u', v); }
+    void _put(short v)                       { _int('i', v); }
+    void _put(unsigned short v)              { _int('u', v); }
+    void _put(int v)                         { _int('i', v); }
+    void _put(unsigned int v)                { _int('u', v); }
+    void _put(long v)                        { _int('i', v); }
+    void _put(unsigned long v)               { _int('u', v); }
+    void _put(float v)                       { _entry('f', &v, sizeof(v)); }
+    void _put(double v)                      { _put((float)v); }
+
+    // Its conversion to uint32_t would otherwise print it as a number
+    void _put(const IPAddress& ip)
+    {
+        uint8_t a[4] = { ip[0], ip[1], ip[2], ip[3] };
+        _entry('a', a, sizeof(a));
+    }
+
+    // String and anything else print() takes
+    template <class T>
+    void _put(const T& v)
+    {
+        if (_full || _len + 2u > sizeof(_b))
+        {
+            _full = true;
+            return;
+        }
+        TinyGsmLogText text(_b + _len + 2, sizeof(_b) - _len - 2);
+        text.print(v);
+        _b[_len] = 's';
+        _b[_len + 1] = text.length();
+        _len += 2 + text.length();
+    }
+
+    void _text(const char* s)
+    {
+        if (_full || _len + 2u > sizeof(_b))
+        {
+            _full = true;
+            return;
+        }
+        uint8_t n = 0;
+        while (s && s[n] && _len + 2u + n < sizeof(_b))
+        {
+            _b[_len + 2 + n] = s[n];
+            n++;
+        }
+        _b[_len] = 's';
+        _b[_len + 1] = n;
+        _len += 2 + n;
+    }
+
+    void _ptr(uint8_t tag, const void* p)
+    {
+        _entry(tag, &p, sizeof(p));
+    }
+
+    void _int(uint8_t tag, int32_t v)
+    {
+        _entry(tag, &v, sizeof(v));
+    }
+
+    // Once an argument doesn't fit, the rest are left out too
+    void _entry(uint8_t tag, const void* p, uint8_t n)
+    {
+        if (_full || _len + 1u + n > sizeof(_b))
+        {
+            _full = true;
+            return;
+        }
+        _b[_len] = tag;
+        memcpy(_b + _len + 1, p, n);
+        _len += 1 + n;
+    }
+
+    uint8_t _b[TINY_GSM_LOG_RECORD > 255 ? 255 : TINY_GSM_LOG_RECORD];
+    uint8_t _len;
+    bool    _full;
+};
+
+template <unsigned N>
+class TinyGsmLogRing
+{
+    static_assert(N && !(N & (N - 1)), "TINY_GSM_DEBUG_DEFERRED must be a power of two");
+
+public:
+    TinyGsmLogRing() : _w(0), _r(0), _lost(0) {}
+
+    bool push(const uint8_t* rec, uint8_t len)
+    {
+        uint32_t w = _w;
+        if (N - (w - _r) < len)
+        {
+            _lost++;
+            return false;
+        }
+        for (uint8_t i = 0; i < len; i++)
+            _b[(w + i) & (N - 1)] = rec[i];
+        __sync_synchronize();
+        _w = w + len;
+        return true;
+    }
+
+    // Copies the oldest record into rec, which must hold 255 bytes
+    bool pop(uint8_t* rec)
+    {
+        uint32_t r = _r;
+        if (r == _w)
+            return false;
+        __sync_synchronize();
+        uint8_t len = _b[r & (N - 1)];
+        for (uint8_t i = 0; i < len; i++)
+            rec[i] = _b[(r + i) & (N - 1)];
+        __sync_synchronize();
+        _r = r + len;
+        return true;
+    }
+
+    bool empty() const
+    {
+        return _r == _w;
+    }
+
+    uint32_t lost() const
+    {
+        return _lost;
+    }
+
+private:
+    uint8_t           _b[N];
+    volatile uint32_t _w;
+    volatile uint32_t _r;
+    volatile uint32_t _lost;
+};
+
+typedef TinyGsmLogRing<TINY_GSM_DEBUG_DEFERRED> TinyGsmLogRingType;
+
+// One ring for the whole program, whichever file logs
+inline TinyGsmLogRingType& TinyGsmLogRingInstance()
+{
+    static TinyGsmLogRingType ring;
+    return ring;
+}
+
+template <typename... Args>
+inline void TinyGsmLogWrite(Args&&... args)
+{
+    TinyGsmLogRecord rec;
+    // Adds the arguments in order
+    int expand[] = { 0, (rec.add(args), 0)... };
+    (void)expand;
+    TinyGsmLogRingInstance().push(rec.data(), rec.length());
+}
+
+inline void TinyGsmLogPrintRecord(Print& out, const uint8_t* rec)
+{
+    uint8_t len = rec[0];
+    uint32_t ms;
+    memcpy(&ms, rec + 1, sizeof(ms));
+    out.print('[');
+    out.print(ms);
+    out.print(F("] "));
+    for (uint8_t i = 1 + sizeof(ms); i < len; )
+    {
+        if (i > 1 + sizeof(ms))
+            out.print(' ');
+        uint8_t tag = rec[i++];
+        const void* p;
+        int32_t v;
+        float f;
+        switch (tag)
+        {
+            case 'p':
+                memcpy(&p, rec + i, sizeof(p));
+                i += sizeof(p);
+                out.print((const __FlashStringHelper*)p);
+                break;
+            case 's':
+                out.write(rec + i + 1, rec[i]);
+                i += 1 + rec[i];
+                break;
+            case 'i':
+            case 'u':
+                memcpy(&v, rec + i, sizeof(v));
+                i += sizeof(v);
+                if (tag == 'i')
+                    out.print((long)v);
+                else
+                    out.print((unsigned long)(uint32_t)v);
+                break;
+            case 'c':
+                out.print((char)rec[i++]);
+                break;
+            case 'f':
+                memcpy(&f, rec + i, sizeof(f));
+                i += sizeof(f);
+                out.print(f);
+                break;
+            case 'a':
+                for (uint8_t k = 0; k < 4; k++)
+                {
+                    if (k)
+                        out.print('.');
+                    out.print(rec[i++]);
+                }
+                break;
+            default:
+                i = len;
+                break;
+        }
+    }
+    out.println();
+}
+
+// Prints up to max records, oldest first, and a note for any that were
+// dropped since the last call.  Returns the number printed.
+inline size_t TinyGsmLogDrain(Print& out, size_t max = (size_t)-1)
+{
+    static uint32_t reported = 0;
+    TinyGsmLogRingType& ring = TinyGsmLogRingInstance();
+    uint8_t rec[255];
+    size_t n = 0;
+    while (n < max && ring.pop(rec))
+    {
+        TinyGsmLogPrintRecord(out, rec);
+        n++;
+    }
+    uint32_t lost = ring.lost();
+    if (lost != reported)
+    {
+        out.print(F("[log] "));
+        out.print(lost - reported);
+        out.println(F(" records dropped"));
+        reported = lost;
+    }
+    return n;
+}
+
+#if defined(ESP32)
+inline bool& TinyGsmLogTaskRunning()
+{
+    static bool running = false;
+    return running;
+}
+
+inline void TinyGsmLogTask(void* out)
+{
+    for (;;)
+    {
+        if (!TinyGsmLogDrain(*(Print*)out, 16))
+            vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+
+// Drains to out from a task of the given priority on core 0, away from
+// the Arduino loop
+inline bool TinyGsmLogStartTask(Print& out, UBaseType_t priority = tskIDLE_PRIORITY + 1)
+{
+    bool& running = TinyGsmLogTaskRunning();
+    if (!running)
+        running = xTaskCreatePinnedToCore(TinyGsmLogTask, "tinygsm_log", 3072,
+                                          &out, priority, NULL, 0) == pdPASS;
+    return running;
+}
+#endif
+
+// Waits up to timeout_ms for everything logged so far to be printed, e.g.
+// before a restart; drains directly if no task does
+inline void TinyGsmLogFlush(Print& out, uint32_t timeout_ms = 1000)
+{
+#if defined(ESP32)
+    if (TinyGsmLogTaskRunning())
+    {
+        for (uint32_t start = millis();
+             !TinyGsmLogRingInstance().empty() && millis() - start < timeout_ms; )
+            delay(1);
+        return;
+    }
+#endif
+    (void)timeout_ms;
+    TinyGsmLogDrain(out);
+}
+
+#endif
@@ -0,0 +1,209 @@
+/**
+ * @file       TinyGsmMatcher.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Nov 2016
+ */
+
+#ifndef TinyGsmMatcher_h
+#define TinyGsmMatcher_h
+
+#if defined(__AVR__)
+  #define TINY_GSM_MATCH_CHAR(p) ((char)pgm_read_byte(p))
+#else
+  #define TINY_GSM_MATCH_CHAR(p) (*(p))
+#endif
+
+// Incremental multi-pattern matcher (Aho-Corasick) for modem responses.
+// Patterns are given ids in the order they are added, starting at 1.  Bytes
+// are fed one at a time and feed() reports the lowest id among the patterns
+// that end at that byte, so the cost per byte does not depend on how many
+// patterns there are or how much text has been received.
+// N is the number of trie nodes (at most 255).
+template <unsigned N>
+class TinyGsmMatcher
+{
+    static_assert(N > 1 && N <= 255, "node indices are 8 bit");
+
+public:
+    TinyGsmMatcher()
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        _n[0].c = 0;
+        _n[0].child = 0;
+        _n[0].next = 0;
+        _n[0].fail = 0;
+        _n[0].out = 0;
+        _nodes = 1;
+        _count = 0;
+        _state = 0;
+    }
+
+    // Returns the pattern id, or 0 if the trie is full, in which case
+    // nothing of the pattern is kept.  A NULL pattern still takes an id, so
+    // callers can keep their numbering fixed.
+    uint8_t add(GsmConstStr pattern)
+    {
+        return add(pattern, _count + 1);
+    }
+
+    // The same with the id given, so patterns can go in out of id order
+    uint8_t add(GsmConstStr pattern, uint8_t id)
+    {
+        if (id > _count)
+            _count = id;
+        const char* p = reinterpret_cast<const char*>(pattern);
+        if (!p)
+            return id;
+        uint8_t s = 0;
+        uint8_t first = 0, firstParent = 0;
+        for (char c; (c = TINY_GSM_MATCH_CHAR(p)) != 0; p++)
+        {
+            uint8_t t = _child(s, c);
+            if (!t)
+            {
+                if (_nodes >= N)
+                {
+                    // New nodes hang off the first one, so unlinking it
+                    // drops them all
+                    if (first)
+                    {
+                        _n[firstParent].child = _n[first].next;
+                        _nodes = first;
+                    }
+                    return 0;
+                }
+                t = _nodes++;
+                if (!first)
+                {
+                    first = t;
+                    firstParent = s;
+                }
+                _n[t].c = c;
+                _n[t].child = 0;
+                _n[t].next = _n[s].child;
+                _n[t].fail = 0;
+                _n[t].out = 0;
+                _n[s].child = t;
+            }
+            s = t;
+        }
+        if (s && (!_n[s].out || id < _n[s].out))
+            _n[s].out = id;
+        return id;
+    }
+
+    // Links every node to its longest proper suffix in the trie; call once
+    // after the last add()
+    void build()
+    {
+        uint8_t q[N];
+        uint8_t head = 0, tail = 0;
+        for (uint8_t t = _n[0].child; t; t = _n[t].next)
+        {
+            _n[t].fail = 0;
+            q[tail++] = t;
+        }
+        while (head < tail)
+        {
+            uint8_t u = q[head++];
+            for (uint8_t v = _n[u].child; v; v = _n[v].next)
+            {
+                uint8_t f = _n[u].fail;
+                uint8_t g;
+                while (!(g = _child(f, _n[v].c)) && f)
+                    f = _n[f].fail;
+                _n[v].fail = g;
+                // A shorter pattern ending here may outrank this one
+                uint8_t o = _n[g].out;
+                if (o && (!_n[v].out || o < _n[v].out))
+                    _n[v].out = o;
+                q[tail++] = v;
+            }
+        }
+        _state = 0;
+    }
+
+    void reset()
+    {
+        _state = 0;
+    }
+
+    // Returns the id of the pattern that ends with this byte, or 0.
+    // Matching starts over after a hit, as the text before it is consumed.
+    uint8_t feed(char c)
+    {
+        uint8_t s = _state;
+        for (;;)
+        {
+            uint8_t t = _child(s, c);
+            if (t)
+            {
+                s = t;
+                break;
+            }
+            if (!s)
+                break;
+            s = _n[s].fail;
+        }
+        uint8_t id = _n[s].out;
+        _state = id ? 0 : s;
+        return id;
+    }
+
+    uint8_t count() const
+    {
+        return _count;
+    }
+
+    uint8_t nodes() const
+    {
+        return _nodes;
+    }
+
+    // Checksum of a pattern's text, chained through h.  The trie keeps no
+    // copy of the patterns, so a caller that reuses it for the same
+    // pointers can tell from this that a RAM buffer has been rewritten.
+    static uint32_t digest(GsmConstStr pattern, uint32_t h = 2166136261UL)
+    {
+        const char* p = reinterpret_cast<const char*>(pattern);
+        if (p)
+        {
+            for (char c; (c = TINY_GSM_MATCH_CHAR(p)) != 0; p++)
+                h = (h ^ (uint8_t)c) * 16777619UL;
+        }
+        return (h ^ 0xFF) * 16777619UL;
+    }
+
+private:
+    uint8_t _child(uint8_t s, char c) const
+    {
+        for (uint8_t t = _n[s].child; t; t = _n[t].next)
+        {
+            if (_n[t].c == c)
+                return t;
+        }
+        return 0;
+    }
+
+    struct Node
+    {
+        char    c;      // label of the edge from the parent
+        uint8_t child;  // first child
+        uint8_t next;   // next sibling
+        uint8_t fail;   // longest proper suffix that is also in the trie
+        uint8_t out;    // lowest pattern id ending here, 0 if none
+    };
+
+    Node     _n[N];
+    uint8_t  _nodes;
+    uint8_t  _count;
+    uint8_t  _state;
+};
+
+#endif
@@ -0,0 +1,337 @@
+/**
+ * @file       TinyGsmTranscript.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Nov 2016
+ */
+
+#ifndef TinyGsmTranscript_h
+#define TinyGsmTranscript_h
+
+#include <Arduino.h>
+
+// Binary AT transcript: the magic "TGT1", then one record per run of bytes
+// going the same way:
+//   tag     bit 7 set for TX (board to modem), bits 0-6 hold length - 1
+//   delta   microseconds since the previous record started, LEB128
+//   data    length bytes
+// The first record has a delta of 0.
+#define TINY_GSM_TRANSCRIPT_MAGIC "TGT1"
+
+// Bytes going the same way within this many microseconds of the start of a
+// run share its record and its timestamp
+#ifndef TINY_GSM_TRANSCRIPT_COALESCE_US
+  #define TINY_GSM_TRANSCRIPT_COALESCE_US 1000
+#endif
+
+// Sits between a driver and the modem's serial port and logs every byte to
+// any Print: a LittleFS File, or a spare Serial to capture on a PC.
+// RX bytes are stamped when the driver reads them.  Call sync() before
+// closing the log, so the last run is written out.
+class TinyGsmStreamRecorder : public Stream
+{
+public:
+    TinyGsmStreamRecorder(Stream& modem, Print& log,
+                          uint32_t coalesce_us = TINY_GSM_TRANSCRIPT_COALESCE_US)
+        : _modem(modem), _log(log), _coalesce(coalesce_us)
+    {
+        _len = 0;
+        _tx = false;
+        _started = false;
+        _last = 0;
+        _runStart = 0;
+    }
+
+    virtual int available()
+    {
+        return _modem.available();
+    }
+
+    virtual int read()
+    {
+        int c = _modem.read();
+        if (c >= 0)
+            _put(false, c);
+        return c;
+    }
+
+    virtual int peek()
+    {
+        return _modem.peek();
+    }
+
+    virtual size_t write(uint8_t c)
+    {
+        _put(true, c);
+        return _modem.write(c);
+    }
+
+    virtual size_t write(const uint8_t* buf, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+            _put(true, buf[i]);
+        return _modem.write(buf, size);
+    }
+
+    virtual void flush()
+    {
+        _modem.flush();
+    }
+
+    void sync()
+    {
+        _flushRun();
+    }
+
+private:
+    void _put(bool tx, uint8_t c)
+    {
+        uint32_t now = micros();
+        if (_len && (tx != _tx || _len == sizeof(_run) ||
+                     now - _runStart > _coalesce))
+            _flushRun();
+        if (!_len)
+        {
+            _tx = tx;
+            _runStart = now;
+        }
+        _run[_len++] = c;
+    }
+
+    void _flushRun()
+    {
+        if (!_len)
+            return;
+        if (!_started)
+        {
+            _log.write((const uint8_t*)TINY_GSM_TRANSCRIPT_MAGIC, 4);
+            _last = _runStart;
+            _started = true;
+        }
+        _log.write((uint8_t)((_tx ? 0x80 : 0) | (_len - 1)));
+        uint32_t d = _runStart - _last;
+        for (; d >= 0x80; d >>= 7)
+            _log.write((uint8_t)(d | 0x80));
+        _log.write((uint8_t)d);
+        _log.write(_run, _len);
+        _last = _runStart;
+        _len = 0;
+    }
+
+    Stream&  _modem;
+    Print&   _log;
+    uint32_t _coalesce;
+    uint8_t  _run[128];
+    uint8_t  _len;
+    bool     _tx;
+    bool     _started;
+    uint32_t _last;
+    uint32_t _runStart;
+};
+
+// Plays a transcript back as the modem, for running a driver off-device.
+// An RX record is only released once the driver has written every TX byte
+// recorded before it, and then after the recorded gap divided by speed.
+// speed 1 keeps the original timing, 10 runs ten times faster and 0 hands
+// out each response as soon as it is due, which leaves only the driver's
+// own CPU time.  TX bytes that differ from the recording are counted, not
+// enforced, so a changed driver can still be run against an old session.
+class TinyGsmStreamReplay : public Stream
+{
+public:
+    TinyGsmStreamReplay(const uint8_t* data, size_t size, float speed = 1.0f)
+        : _data(data), _size(size), _speed(speed)
+    {
+        rewind();
+    }
+
+    void rewind()
+    {
+        bool ok = _size >= 4 && !memcmp(_data, TINY_GSM_TRANSCRIPT_MAGIC, 4);
+        _rxPos = _txPos = ok ? 4 : _size;
+        _rxLen = _rxOff = 0;
+        _txLen = _txOff = 0;
+        _rxTime = _txTime = 0;
+        _rxGate = 0;
+        _rxDue = false;
+        _txWritten = 0;
+        _rxDoneAt = _txGateAt = _txStartAt = micros();
+        _rxBytes = 0;
+        _mismatches = 0;
+        _loadRx();
+    }
+
+    virtual int available()
+    {
+        if (!_rxReady())
+            return 0;
+        return _rxLen - _rxOff;
+    }
+
+    virtual int read()
+    {
+        if (!_rxReady())
+            return -1;
+        uint8_t c = _data[_rxData + _rxOff++];
+        _rxBytes++;
+        if (_rxOff == _rxLen)
+        {
+            _rxDoneAt = micros();
+            _loadRx();
+        }
+        return c;
+    }
+
+    virtual int peek()
+    {
+        if (!_rxReady())
+            return -1;
+        return _data[_rxData + _rxOff];
+    }
+
+    virtual size_t write(uint8_t c)
+    {
+        if (!_txOff)
+            _txStartAt = micros();
+        if (_txOff == _txLen && !_nextRecord(_txPos, true, _txLen, _txData, _txTime))
+        {
+            _mismatches++;
+        }
+        else
+        {
+            if (_data[_txData + _txOff] != c)
+                _mismatches++;
+            if (++_txOff == _txLen)
+                _txOff = _txLen = 0;
+        }
+        // The gap before an RX record is timed from the start of the TX
+        // record it answers
+        if (++_txWritten == _rxGate)
+            _txGateAt = _txStartAt;
+        return 1;
+    }
+
+    virtual size_t write(const uint8_t* buf, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+            write(buf[i]);
+        return size;
+    }
+
+    virtual void flush() {}
+
+    // All RX records have been handed out
+    bool finished()
+    {
+        return !_rxLen && _rxPos >= _size;
+    }
+
+    uint32_t mismatches() const
+    {
+        return _mismatches;
+    }
+
+    uint32_t rxBytes() const
+    {
+        return _rxBytes;
+    }
+
+    uint32_t txBytes() const
+    {
+        return _txWritten;
+    }
+
+private:
+    // Loaded as soon as the previous one is used up, so that write() knows
+    // which TX byte opens its gate
+    void _loadRx()
+    {
+        uint32_t txBefore = 0;
+        uint32_t before = _rxTime;
+        _rxOff = 0;
+        _rxDue = false;
+        if (!_nextRecord(_rxPos, false, _rxLen, _rxData, _rxTime, &txBefore, &before))
+        {
+            _rxLen = 0;
+            return;
+        }
+        _rxGate += txBefore;
+        _rxGap = _rxTime - before;
+    }
+
+    bool _rxReady()
+    {
+        if (_rxOff >= _rxLen)
+            return false;
+        if (_rxDue)
+            return true;
+        if (_txWritten < _rxGate)
+            return false;
+        uint32_t start = _rxDoneAt;
+        if (_rxGate && (int32_t)(_txGateAt - start) > 0)
+            start = _txGateAt;
+        uint32_t wait = _speed > 0 ? (uint32_t)(_rxGap / _speed) : 0;
+        _rxDue = micros() - start >= wait;
+        return _rxDue;
+    }
+
+    // Moves pos past records going the other way (adding up their lengths
+    // in skipped) and loads the next record going the wanted way.  time is
+    // advanced to that record's timestamp, before to the one just ahead of it.
+    bool _nextRecord(size_t& pos, bool tx, uint8_t& len, size_t& data,
+                     uint32_t& time, uint32_t* skipped = NULL,
+                     uint32_t* before = NULL)
+    {
+        while (pos < _size)
+        {
+            uint8_t tag = _data[pos++];
+            uint32_t d = 0;
+            for (uint8_t shift = 0; pos < _size; shift += 7)
+            {
+                uint8_t b = _data[pos++];
+                d |= (uint32_t)(b & 0x7F) << shift;
+                if (!(b & 0x80))
+                    break;
+            }
+            if (before)
+                *before = time;
+            time += d;
+            uint8_t n = (tag & 0x7F) + 1;
+            if (pos + n > _size)
+            {
+                pos = _size;
+                return false;
+            }
+            if (!!(tag & 0x80) == tx)
+            {
+                len = n;
+                data = pos;
+                pos += n;
+                return true;
+            }
+            if (skipped)
+                *skipped += n;
+            pos += n;
+        }
+        return false;
+    }
+
+    const uint8_t* _data;
+    size_t   _size;
+    float    _speed;
+    size_t   _rxPos, _txPos;
+    size_t   _rxData, _txData;
+    uint8_t  _rxLen, _rxOff;
+    uint8_t  _txLen, _txOff;
+    uint32_t _rxTime, _txTime;
+    uint32_t _rxGap;
+    uint32_t _rxGate;
+    bool     _rxDue;
+    uint32_t _txWritten;
+    uint32_t _rxDoneAt, _txGateAt, _txStartAt;
+    uint32_t _rxBytes;
+    uint32_t _mismatches;
+};
+
+#endif
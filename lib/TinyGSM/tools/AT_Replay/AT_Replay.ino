@@ -0,0 +1,83 @@
+/**************************************************************
+ *
+ * This script plays a recorded AT transcript back into a
+ * driver, so a field session can be re-run off-device and
+ * timed after every change to the library.
+ *
+ * Record a session by putting TinyGsmStreamRecorder between
+ * the modem and its serial port:
+ *
+ *   File log = LittleFS.open("/session.tgt", "w");
+ *   TinyGsmStreamRecorder rec(SerialAT, log);
+ *   TinyGsm modem(rec);
+ *   ...
+ *   rec.sync(); log.close();
+ *
+ * then convert it with  xxd -i -n transcript session.tgt > transcript.h
+ * and make session() below make the same calls as the recorded
+ * program did.
+ *
+ * TinyGSM Getting Started guide:
+ *   https://tiny.cc/tinygsm-readme
+ *
+ **************************************************************/
+
+// Select the modem the transcript was recorded with:
+#define TINY_GSM_MODEM_SIM800
+// #define TINY_GSM_MODEM_SIM900
+// #define TINY_GSM_MODEM_SIM7600
+// #define TINY_GSM_MODEM_UBLOX
+// #define TINY_GSM_MODEM_M95
+// #define TINY_GSM_MODEM_BG96
+// #define TINY_GSM_MODEM_MC60
+
+// Set serial for the report
+#define SerialMon Serial
+
+// 1 keeps the recorded timing, 10 runs ten times faster, 0 replies as soon
+// as each command is written, which leaves only the driver's CPU time
+#define REPLAY_SPEED 0
+
+// Runs the recorded session this many times
+#define REPLAY_ROUNDS 10
+
+#include <TinyGsmClient.h>
+#include <TinyGsmTranscript.h>
+#include "transcript.h"
+
+TinyGsmStreamReplay replay(transcript, sizeof(transcript), REPLAY_SPEED);
+TinyGsm modem(replay);
+
+// The calls the recorded program made, in the same order
+void session() {
+  modem.testAT(1000);
+}
+
+void setup() {
+  SerialMon.begin(115200);
+  delay(10);
+
+  uint32_t best = 0xFFFFFFFF, total = 0;
+  for (int i = 0; i < REPLAY_ROUNDS; i++) {
+    replay.rewind();
+    uint32_t start = micros();
+    session();
+    uint32_t us = micros() - start;
+    total += us;
+    if (us < best) best = us;
+    if (!replay.finished() || replay.mismatches()) {
+      SerialMon.print(F("Round ")); SerialMon.print(i);
+      SerialMon.print(F(": diverged, ")); SerialMon.print(replay.mismatches());
+      SerialMon.print(F(" TX bytes differ, finished="));
+      SerialMon.println(replay.finished());
+    }
+  }
+
+  SerialMon.print(F("TX bytes:  ")); SerialMon.println(replay.txBytes());
+  SerialMon.print(F("RX bytes:  ")); SerialMon.println(replay.rxBytes());
+  SerialMon.print(F("Best us:   ")); SerialMon.println(best);
+  SerialMon.print(F("Mean us:   ")); SerialMon.println(total / REPLAY_ROUNDS);
+}
+
+void loop() {
+}
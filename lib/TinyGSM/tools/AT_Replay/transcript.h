@@ -0,0 +1,9 @@
+// Transcript played back by AT_Replay.ino.  Replace it with a recorded
+// session, e.g.:  xxd -i -n transcript session.tgt > transcript.h
+// This one is just "AT" answered by "OK" 2 ms later.
+const unsigned char transcript[] = {
+  0x54, 0x47, 0x54, 0x31,                          // "TGT1"
+  0x83, 0x00, 0x41, 0x54, 0x0d, 0x0a,              // TX "AT\r\n"
+  0x05, 0xd0, 0x0f, 0x0d, 0x0a, 0x4f, 0x4b, 0x0d,  // RX after 2000 us
+  0x0a                                             //    "\r\nOK\r\n"
+};
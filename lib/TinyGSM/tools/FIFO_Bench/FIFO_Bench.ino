@@ -0,0 +1,140 @@
+/**************************************************************
+ *
+ * This script measures the CPU cost of moving a socket payload
+ * from the modem's serial stream into a GsmClient's FIFO, in
+ * cycles per byte, with no modem attached: the payload is
+ * served from memory, so only the copy itself is timed.  It
+ * compares
+ *   per byte   available() and read() per byte, with the
+ *              timeout checked every time (the old macro)
+ *   bulk       TinyGsmStreamToFifo(): readBytes() straight
+ *              into the FIFO's free span
+ * for a few payload sizes a modem hands out per read.  Only
+ * figures taken on the board count: built for a PC against
+ * Arduino stand-ins, the per-byte column mostly times the
+ * stand-in millis().
+ *
+ * TinyGSM Getting Started guide:
+ *   https://tiny.cc/tinygsm-readme
+ *
+ **************************************************************/
+
+#define TINY_GSM_MODEM_SIM800
+
+// Set serial for the report
+#define SerialMon Serial
+
+#define TINY_GSM_RX_BUFFER 1500
+
+// Copies timed per method and size
+#define BENCH_ROUNDS 200
+
+#include <TinyGsmClient.h>
+
+#if defined(ESP32) || defined(ESP8266)
+  #define BENCH_CYCLES() ESP.getCycleCount()
+#else
+  // Coarse, but enough for a per-byte figure over many rounds
+  #define BENCH_CYCLES() (micros() * (F_CPU / 1000000UL))
+#endif
+
+// Serves the same payload over and over, the way a UART driver hands out
+// bytes it has already received
+class PayloadStream : public Stream
+{
+public:
+    PayloadStream() : _len(0), _pos(0)
+    {
+        for (size_t i = 0; i < sizeof(_buf); i++)
+            _buf[i] = (uint8_t)i;
+    }
+
+    void serve(size_t len)
+    {
+        _len = len;
+        _pos = 0;
+    }
+
+    virtual int available() { return _len - _pos; }
+    virtual int read() { return _pos < _len ? _buf[_pos++] : -1; }
+    virtual int peek() { return _pos < _len ? _buf[_pos] : -1; }
+    virtual void flush() {}
+    virtual size_t write(uint8_t) { return 1; }
+
+    virtual size_t readBytes(char* buffer, size_t length)
+    {
+        if (length > _len - _pos)
+            length = _len - _pos;
+        memcpy(buffer, _buf + _pos, length);
+        _pos += length;
+        return length;
+    }
+
+private:
+    uint8_t _buf[TINY_GSM_RX_BUFFER];
+    size_t  _len, _pos;
+};
+
+PayloadStream stream;
+TinyGsmFifo<uint8_t, TINY_GSM_RX_BUFFER> fifo;
+
+enum Method { PER_BYTE, BULK };
+
+void copy(Method method, size_t len) {
+  const uint32_t timeout_ms = 1000;
+  switch (method) {
+    case PER_BYTE:
+      for (size_t i = 0; i < len; i++) {
+        uint32_t startMillis = millis();
+        while (!stream.available() && (millis() - startMillis < timeout_ms)) { TINY_GSM_YIELD(); }
+        char c = stream.read();
+        fifo.put(c);
+      }
+      break;
+    case BULK:
+      TinyGsmStreamToFifo(stream, fifo, len, timeout_ms);
+      break;
+  }
+}
+
+// Cycles per byte, in hundredths
+uint32_t bench(Method method, size_t len) {
+  uint32_t cycles = 0;
+  for (int i = 0; i < BENCH_ROUNDS; i++) {
+    stream.serve(len);
+    fifo.clear();
+    uint32_t start = BENCH_CYCLES();
+    copy(method, len);
+    cycles += BENCH_CYCLES() - start;
+    if (fifo.size() != len) {
+      SerialMon.println(F("short copy"));
+    }
+  }
+  return (uint32_t)((uint64_t)cycles * 100 / ((uint64_t)len * BENCH_ROUNDS));
+}
+
+void report(uint32_t centi) {
+  SerialMon.print(centi / 100);
+  SerialMon.print('.');
+  if (centi % 100 < 10) SerialMon.print('0');
+  SerialMon.print(centi % 100);
+}
+
+void setup() {
+  SerialMon.begin(115200);
+  delay(10);
+
+  static const size_t sizes[] = { 64, 256, 1024, 1460 };
+  SerialMon.println(F("bytes  per byte  bulk   (cycles/byte)"));
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    SerialMon.print(sizes[i]);
+    SerialMon.print(F("   "));
+    report(bench(PER_BYTE, sizes[i]));
+    SerialMon.print(F("   "));
+    report(bench(BULK, sizes[i]));
+    SerialMon.println();
+  }
+}
+
+void loop() {
+}
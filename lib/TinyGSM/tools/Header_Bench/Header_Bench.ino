@@ -0,0 +1,199 @@
+/**************************************************************
+ *
+ * This script measures how fast HTTP response headers can be
+ * parsed through a GsmClient, with no modem attached: a small
+ * SIM800 stand-in answers the driver's AT commands and serves
+ * the same response over and over.  It compares
+ *   readStringUntil()  a virtual read() per byte
+ *   readUntil()        memchr() over the socket FIFO
+ *   find()             skipping the headers entirely
+ *
+ * TinyGSM Getting Started guide:
+ *   https://tiny.cc/tinygsm-readme
+ *
+ **************************************************************/
+
+#define TINY_GSM_MODEM_SIM800
+
+// Set serial for the report
+#define SerialMon Serial
+
+#define TINY_GSM_RX_BUFFER 1024
+
+// Responses parsed per method
+#define BENCH_ROUNDS 50
+
+#include <TinyGsmClient.h>
+
+const char response[] =
+  "HTTP/1.1 200 OK\r\n"
+  "Server: nginx/1.18.0 (Ubuntu)\r\n"
+  "Date: Tue, 25 Aug 2020 03:27:28 GMT\r\n"
+  "Content-Type: application/octet-stream\r\n"
+  "Content-Length: 4\r\n"
+  "Connection: keep-alive\r\n"
+  "Last-Modified: Tue, 25 Aug 2020 03:27:28 GMT\r\n"
+  "ETag: \"5f4484a0-e4a10\"\r\n"
+  "X-MD5: 0f343b0931126a20f133d67c2b018a3b\r\n"
+  "Accept-Ranges: bytes\r\n"
+  "Strict-Transport-Security: max-age=31536000; includeSubDomains\r\n"
+  "X-Content-Type-Options: nosniff\r\n"
+  "X-Frame-Options: SAMEORIGIN\r\n"
+  "Cache-Control: no-cache, no-store, must-revalidate\r\n"
+  "\r\n"
+  "BODY";
+
+// Answers the commands a SIM800 socket uses, serving response on every
+// connection
+class FakeSim800 : public Stream
+{
+public:
+    FakeSim800() : _outLen(0), _outPos(0), _inLen(0), _sent(0) {}
+
+    virtual int available() { return _outLen - _outPos; }
+    virtual int read() { return _outPos < _outLen ? (uint8_t)_out[_outPos++] : -1; }
+    virtual int peek() { return _outPos < _outLen ? (uint8_t)_out[_outPos] : -1; }
+    virtual void flush() {}
+
+    virtual size_t write(uint8_t c)
+    {
+        if (_inLen < sizeof(_in) - 1)
+            _in[_inLen++] = c;
+        if (c == '\n')
+        {
+            _in[_inLen] = '\0';
+            _command(_in);
+            _inLen = 0;
+        }
+        return 1;
+    }
+
+private:
+    void _reply(const char* s, size_t len)
+    {
+        if (_outPos == _outLen)
+            _outPos = _outLen = 0;
+        if (len > sizeof(_out) - _outLen)
+            len = sizeof(_out) - _outLen;
+        memcpy(_out + _outLen, s, len);
+        _outLen += len;
+    }
+
+    void _reply(const char* s)
+    {
+        _reply(s, strlen(s));
+    }
+
+    void _command(const char* cmd)
+    {
+        const size_t total = sizeof(response) - 1;
+        char line[64];
+        int mux, n;
+        if (sscanf(cmd, "AT+CIPRXGET=2,%d,%d", &mux, &n) == 2)
+        {
+            size_t k = total - _sent;
+            if ((size_t)n < k)
+                k = n;
+            snprintf(line, sizeof(line), "\r\n+CIPRXGET: 2,%d,%u,%u\r\n", mux,
+                     (unsigned)k, (unsigned)(total - _sent - k));
+            _reply(line);
+            _reply(response + _sent, k);
+            _reply("\r\nOK\r\n");
+            _sent += k;
+        }
+        else if (sscanf(cmd, "AT+CIPRXGET=4,%d", &mux) == 1)
+        {
+            snprintf(line, sizeof(line), "\r\n+CIPRXGET: 4,%d,%u\r\n\r\nOK\r\n", mux,
+                     (unsigned)(total - _sent));
+            _reply(line);
+        }
+        else if (sscanf(cmd, "AT+CIPSTART=%d", &mux) == 1)
+        {
+            // Data is announced as soon as the connection is up
+            _sent = 0;
+            snprintf(line, sizeof(line), "\r\nOK\r\n\r\n%d, CONNECT OK\r\n\r\n+CIPRXGET: 1,%d\r\n",
+                     mux, mux);
+            _reply(line);
+        }
+        else if (sscanf(cmd, "AT+CIPSTATUS=%d", &mux) == 1)
+        {
+            snprintf(line, sizeof(line), "\r\n+CIPSTATUS: %d,0,\"TCP\",\"1.2.3.4\",\"80\",\"CONNECTED\"\r\n\r\nOK\r\n", mux);
+            _reply(line);
+        }
+        else
+        {
+            _reply("\r\nOK\r\n");
+        }
+    }
+
+    char   _out[1536];
+    size_t _outLen, _outPos;
+    char   _in[128];
+    size_t _inLen;
+    size_t _sent;
+};
+
+FakeSim800    fake;
+TinyGsm       modem(fake);
+TinyGsmClient client(modem);
+
+enum Method { READ_STRING, READ_UNTIL, FIND };
+
+// Parses one response, returning the number of header lines seen
+int parse(Method method) {
+  client.connect("bench", 80);
+  int lines = 0;
+  switch (method) {
+    case READ_STRING:
+      for (;;) {
+        String line = client.readStringUntil('\n');
+        if (line.length() <= 1) break;
+        lines++;
+      }
+      break;
+    case READ_UNTIL: {
+      char line[128];
+      for (;;) {
+        size_t len = client.readUntil('\n', line, sizeof(line));
+        if (len <= 1) break;
+        lines++;
+      }
+      break;
+    }
+    case FIND:
+      lines = client.find("\r\n\r\n") ? 1 : 0;
+      break;
+  }
+  char body[4];
+  client.readBytes(body, sizeof(body));
+  return lines;
+}
+
+void bench(Method method, const char* name) {
+  uint32_t start = micros();
+  int lines = 0;
+  for (int i = 0; i < BENCH_ROUNDS; i++) {
+    lines += parse(method);
+  }
+  uint32_t us = micros() - start;
+  SerialMon.print(name);
+  SerialMon.print(us / BENCH_ROUNDS);
+  SerialMon.print(F(" us per response, "));
+  SerialMon.print((uint32_t)((uint64_t)(sizeof(response) - 1) * BENCH_ROUNDS * 1000 / us));
+  SerialMon.print(F(" kB/s, "));
+  SerialMon.print(lines / BENCH_ROUNDS);
+  SerialMon.println(F(" lines"));
+}
+
+void setup() {
+  SerialMon.begin(115200);
+  delay(10);
+
+  client.setTimeout(1000);
+  bench(READ_STRING, "readStringUntil  ");
+  bench(READ_UNTIL, "readUntil        ");
+  bench(FIND, "find             ");
+}
+
+void loop() {
+}
@@ -0,0 +1,77 @@
+/**************************************************************
+ *
+ * This script measures how long a DBG() call holds up its
+ * caller, with no modem attached.  Flash it twice:
+ *   BENCH_DEFERRED 0   DBG() prints straight to the console and
+ *                      waits whenever the UART is full
+ *   BENCH_DEFERRED 1   DBG() packs a record into the deferred
+ *                      log ring (TinyGsmLog.h) and a background
+ *                      task prints it
+ * Lines are logged in a burst, the way state changes come in,
+ * each with a flash string, numbers, a copied string and an
+ * address.  The app's own "Flashed ... kB/s" line shows what
+ * the difference does to an OTA download.
+ *
+ * TinyGSM Getting Started guide:
+ *   https://tiny.cc/tinygsm-readme
+ *
+ **************************************************************/
+
+#define TINY_GSM_MODEM_SIM800
+
+// Set serial for the log and the report
+#define SerialMon Serial
+
+#define TINY_GSM_DEBUG SerialMon
+#define TINY_GSM_DEBUG_LEVEL 1
+
+// 1 times the deferred log, 0 direct output
+#define BENCH_DEFERRED 0
+
+#if BENCH_DEFERRED
+  #define TINY_GSM_DEBUG_DEFERRED 4096
+#endif
+
+// Lines logged back to back
+#define BENCH_LINES 50
+
+#include <TinyGsmClient.h>
+
+void setup() {
+  SerialMon.begin(115200);
+  delay(10);
+
+#if BENCH_DEFERRED && defined(ESP32)
+  TinyGsmLogStartTask(SerialMon);
+#endif
+
+  char host[] = "example.com";
+  IPAddress ip(93, 184, 216, 34);
+  uint32_t total = 0;
+  uint32_t worst = 0;
+  for (int i = 0; i < BENCH_LINES; i++) {
+    uint32_t start = micros();
+    DBG(F("[bench] line"), i, F("of"), BENCH_LINES, host, F("="), ip);
+    uint32_t us = micros() - start;
+    total += us;
+    if (us > worst) worst = us;
+#if BENCH_DEFERRED && !defined(ESP32)
+    // No task to print it, so outside the timed part
+    TinyGsmLogDrain(SerialMon);
+#endif
+  }
+#if BENCH_DEFERRED
+  TinyGsmLogFlush(SerialMon);
+#endif
+  SerialMon.flush();
+
+  SerialMon.println();
+  SerialMon.print(BENCH_DEFERRED ? F("deferred") : F("direct"));
+  SerialMon.print(F(": us per line, average "));
+  SerialMon.print(total / BENCH_LINES);
+  SerialMon.print(F(", worst "));
+  SerialMon.println(worst);
+}
+
+void loop() {
+}
@@ -0,0 +1,262 @@
+/**************************************************************
+ *
+ * A SIM800 stand-in for SIM800_Emulator: answers the commands the
+ * driver sends for a multi-IP, manual-receive socket straight from
+ * memory, and can be told to misbehave the way a real modem does
+ * only now and then.
+ *
+ **************************************************************/
+
+#ifndef FakeSim800_h
+#define FakeSim800_h
+
+class FakeSim800 : public Stream
+{
+public:
+    // How CIPSEND is answered
+    enum SendMode
+    {
+        SEND_ACCEPT,  // prompt, then DATA ACCEPT
+        SEND_REFUSE,  // ERROR instead of the prompt
+        SEND_FAIL,    // prompt, then "<mux>, SEND FAIL"
+        SEND_SILENT   // prompt, then nothing until ackLate()
+    };
+
+    FakeSim800() : _outLen(0), _outPos(0) { reset(); }
+
+    // Back to a modem that accepts everything, with counters cleared.
+    // Whatever it has already said stays for the driver to read.
+    void reset()
+    {
+        sendMode = SEND_ACCEPT;
+        commands = sends = 0;
+        closed = false;
+        sentLen = 0;
+        _inLen = 0;
+        _sendLeft = 0;
+        _unacked = 0;
+        polls = 0;
+        held = arrived = 0;
+        ipState = "IP STATUS";
+        cipmux = 1;
+        attached = true;
+    }
+
+    // n more bytes reach the socket, announced by a URC or silently the
+    // way a modem now and then forgets to.  Byte i of the stream is i & 0xFF.
+    void arrive(size_t n, bool urc)
+    {
+        held += n;
+        arrived += n;
+        if (urc)
+            this->urc("\r\n+CIPRXGET: 1,1\r\n");
+    }
+
+    // An unsolicited line, as if the modem had just sent it
+    void urc(const char* line)
+    {
+        _reply(line);
+    }
+
+    // Sends that SEND_SILENT left unanswered
+    uint8_t unacked() const { return _unacked; }
+
+    // The DATA ACCEPTs held back in SEND_SILENT, all at once
+    void ackLate()
+    {
+        for (uint8_t i = 0; i < _unacked; i++)
+            _accept(_unackedMux[i], _unackedLen[i]);
+        _unacked = 0;
+    }
+
+    virtual int available() { return _outLen - _outPos; }
+    virtual int read() { return _outPos < _outLen ? (uint8_t)_out[_outPos++] : -1; }
+    virtual int peek() { return _outPos < _outLen ? (uint8_t)_out[_outPos] : -1; }
+    virtual void flush() {}
+
+    virtual size_t write(uint8_t c)
+    {
+        if (_sendLeft)
+        {
+            // Payload after the '>' prompt
+            if (sentLen < sizeof(sent))
+                sent[sentLen++] = c;
+            if (!--_sendLeft)
+                _sendDone();
+            return 1;
+        }
+        if (_inLen < sizeof(_in) - 1)
+            _in[_inLen++] = c;
+        if (c == '\n')
+        {
+            _in[_inLen] = '\0';
+            _command(_in);
+            _inLen = 0;
+        }
+        return 1;
+    }
+
+    SendMode sendMode;
+    uint32_t commands;  // AT commands seen
+    uint32_t sends;     // of them CIPSEND
+    bool     closed;    // a CIPCLOSE came
+    char     sent[64];  // payload of the sends, as far as it fits
+    size_t   sentLen;
+    uint32_t polls;     // AT+CIPRXGET=4, asking how much is held
+    size_t   held;      // bytes waiting in the modem
+    size_t   arrived;   // bytes that ever came in
+    const char* ipState;  // what AT+CIPSTATUS reports
+    int      cipmux;    // 1 multi-IP, 0 single-IP
+    bool     attached;  // the GPRS bearer, AT+CGATT?
+
+protected:
+    // Moves what the driver hasn't read yet to the front
+    void _compact()
+    {
+        memmove(_out, _out + _outPos, _outLen - _outPos);
+        _outLen -= _outPos;
+        _outPos = 0;
+    }
+
+    void _reply(const char* s, size_t len)
+    {
+        _compact();
+        if (len > sizeof(_out) - _outLen)
+            len = sizeof(_out) - _outLen;
+        memcpy(_out + _outLen, s, len);
+        _outLen += len;
+    }
+
+    void _reply(const char* s)
+    {
+        _reply(s, strlen(s));
+    }
+
+    void _accept(int mux, size_t len)
+    {
+        char line[40];
+        snprintf(line, sizeof(line), "\r\nDATA ACCEPT:%d,%u\r\n", mux, (unsigned)len);
+        _reply(line);
+    }
+
+    void _sendDone()
+    {
+        char line[40];
+        switch (sendMode)
+        {
+        case SEND_FAIL:
+            snprintf(line, sizeof(line), "\r\n%d, SEND FAIL\r\n", _sendMux);
+            _reply(line);
+            break;
+        case SEND_SILENT:
+            if (_unacked < sizeof(_unackedMux))
+            {
+                _unackedMux[_unacked] = _sendMux;
+                _unackedLen[_unacked] = _sendLen;
+                _unacked++;
+            }
+            break;
+        default:
+            _accept(_sendMux, _sendLen);
+            break;
+        }
+    }
+
+    void _command(const char* cmd)
+    {
+        char line[80];
+        int mux, n;
+        commands++;
+        if (sscanf(cmd, "AT+CIPSEND=%d,%d", &mux, &n) == 2)
+        {
+            sends++;
+            if (sendMode == SEND_REFUSE)
+            {
+                _reply("\r\nERROR\r\n");
+                return;
+            }
+            _sendMux = mux;
+            _sendLen = _sendLeft = n;
+            _reply("\r\n> ");
+        }
+        else if (sscanf(cmd, "AT+CIPRXGET=4,%d", &mux) == 1)
+        {
+            polls++;
+            snprintf(line, sizeof(line), "\r\n+CIPRXGET: 4,%d,%u\r\n\r\nOK\r\n", mux, (unsigned)held);
+            _reply(line);
+        }
+        else if (sscanf(cmd, "AT+CIPRXGET=2,%d,%d", &mux, &n) == 2)
+        {
+            // Leaves room for the reply around the payload
+            _compact();
+            size_t room = sizeof(_out) - _outLen;
+            size_t len = (size_t)n < held ? n : held;
+            if (len + 64 > room)
+                len = room > 64 ? room - 64 : 0;
+            snprintf(line, sizeof(line), "\r\n+CIPRXGET: 2,%d,%u,%u\r\n", mux, (unsigned)len,
+                     (unsigned)(held - len));
+            _reply(line);
+            for (size_t i = 0; i < len; i++)
+                _out[_outLen++] = (char)(arrived - held + i);
+            held -= len;
+            _reply("\r\nOK\r\n");
+        }
+        else if (sscanf(cmd, "AT+CIPSTART=%d", &mux) == 1)
+        {
+            closed = false;
+            snprintf(line, sizeof(line), "\r\nOK\r\n\r\n%d, CONNECT OK\r\n", mux);
+            _reply(line);
+        }
+        else if (sscanf(cmd, "AT+CIPSTATUS=%d", &mux) == 1)
+        {
+            snprintf(line, sizeof(line), "\r\n+CIPSTATUS: %d,0,\"TCP\",\"1.2.3.4\",\"80\",\"%s\"\r\n\r\nOK\r\n",
+                     mux, closed ? "CLOSED" : "CONNECTED");
+            _reply(line);
+        }
+        else if (!strcmp(cmd, "AT+CIPSTATUS\r\n"))
+        {
+            snprintf(line, sizeof(line), "\r\nOK\r\n\r\nSTATE: %s\r\n", ipState);
+            _reply(line);
+            if (cipmux && strcmp(ipState, "IP INITIAL"))
+            {
+                // A line per connection in multi-IP mode
+                for (mux = 0; mux < 6; mux++)
+                {
+                    snprintf(line, sizeof(line), "C: %d,,\"\",\"\",\"\",\"INITIAL\"\r\n", mux);
+                    _reply(line);
+                }
+            }
+        }
+        else if (!strcmp(cmd, "AT+CIPMUX?\r\n"))
+        {
+            snprintf(line, sizeof(line), "\r\n+CIPMUX: %d\r\n\r\nOK\r\n", cipmux);
+            _reply(line);
+        }
+        else if (!strcmp(cmd, "AT+CGATT?\r\n"))
+        {
+            snprintf(line, sizeof(line), "\r\n+CGATT: %d\r\n\r\nOK\r\n", attached);
+            _reply(line);
+        }
+        else if (sscanf(cmd, "AT+CIPCLOSE=%d", &mux) == 1)
+        {
+            closed = true;
+            _reply("\r\nOK\r\n");
+        }
+        else
+        {
+            _reply("\r\nOK\r\n");
+        }
+    }
+
+    char   _out[1536];
+    size_t _outLen, _outPos;
+    char   _in[128];
+    size_t _inLen;
+    int    _sendMux;
+    size_t _sendLen, _sendLeft;
+    uint8_t _unacked;
+    uint8_t _unackedMux[8];
+    size_t  _unackedLen[8];
+};
+
+#endif
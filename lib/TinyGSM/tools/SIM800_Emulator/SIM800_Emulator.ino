@@ -0,0 +1,294 @@
+/**************************************************************
+ *
+ * This script runs the SIM800 driver through situations that a
+ * real modem only gets into now and then, with no modem
+ * attached: FakeSim800.h answers the driver's AT commands from
+ * memory and can be told to misbehave.  Each scenario prints
+ * what the driver did, so builds can be compared.
+ *   TX buffer   a short write going out from maintain(), the
+ *               back-off while the modem refuses sends, and the
+ *               buffered bytes surviving until it recovers
+ *   send window sends that are not waited for: a SEND FAIL
+ *               coming in later, a modem that stops
+ *               acknowledging, and its late acknowledgements
+ *   polling     fallback polls while a client reads for 20 s and
+ *               data comes in without a URC, never, every 5 s
+ *               and every second
+ *   URC drain   how long maintain() takes over a waiting URC,
+ *               against a waitResponse() with nothing to match,
+ *               and the commands idle maintain() calls send
+ *   resume      gprsResume() from every state a modem can be
+ *               left in when only the ESP restarts
+ *
+ * TinyGSM Getting Started guide:
+ *   https://tiny.cc/tinygsm-readme
+ *
+ **************************************************************/
+
+#define TINY_GSM_MODEM_SIM800
+
+// Set serial for the report
+#define SerialMon Serial
+
+#define TINY_GSM_TX_BUFFER 16
+#define TINY_GSM_SEND_WINDOW 3
+
+#include <TinyGsmClient.h>
+#include "FakeSim800.h"
+
+FakeSim800    fake;
+TinyGsm       modem(fake);
+TinyGsmClient client(modem, 1);
+
+void connect() {
+  fake.reset();
+  client.clearWriteError();
+  client.connect("emulator", 80);
+  fake.reset();
+}
+
+void txBuffer() {
+  SerialMon.println(F("TX buffer"));
+
+  // A write too short to fill the buffer, and nothing else to send it
+  connect();
+  client.write((const uint8_t*)"hello", 5);
+  uint32_t start = millis();
+  while (!fake.sends && millis() - start < 1000) {
+    modem.maintain();
+  }
+  SerialMon.print(F("  5 bytes sent by maintain() after "));
+  SerialMon.print(millis() - start);
+  SerialMon.println(F(" ms"));
+
+  // Every send refused: retries back off, then the socket is given up
+  connect();
+  fake.sendMode = FakeSim800::SEND_REFUSE;
+  client.write((const uint8_t*)"0123456789abcdef", 16);
+  start = millis();
+  uint32_t tries = fake.sends;
+  SerialMon.print(F("  refused sends at"));
+  while (!fake.closed && millis() - start < 10000) {
+    client.available();
+    if (fake.sends != tries) {
+      tries = fake.sends;
+      SerialMon.print(' ');
+      SerialMon.print(millis() - start);
+    }
+  }
+  SerialMon.print(F(" ms, socket closed after "));
+  SerialMon.print(millis() - start);
+  SerialMon.println(F(" ms"));
+
+  // Refused once, then accepted: flush() sends the bytes kept
+  connect();
+  fake.sendMode = FakeSim800::SEND_REFUSE;
+  client.write((const uint8_t*)"0123456789abcdef", 16);
+  SerialMon.print(F("  refused: write error "));
+  SerialMon.print(client.getWriteError());
+  fake.sendMode = FakeSim800::SEND_ACCEPT;
+  client.flush();
+  SerialMon.print(F(", after flush() the modem got "));
+  SerialMon.print(fake.sentLen);
+  SerialMon.print(F(" bytes, "));
+  SerialMon.println(fake.sentLen == 16 && !memcmp(fake.sent, "0123456789abcdef", 16)
+                    ? F("intact") : F("not intact"));
+  client.stop();
+}
+
+// Longer than the TX buffer, so every write goes straight to modemSend
+static const uint8_t block[32] = { 0 };
+
+void sendWindow() {
+  SerialMon.println(F("send window"));
+
+  // The send is taken, its SEND FAIL only comes with the next command
+  connect();
+  fake.sendMode = FakeSim800::SEND_FAIL;
+  size_t n = client.write(block, sizeof(block));
+  SerialMon.print(F("  SEND FAIL: write() took "));
+  SerialMon.print(n);
+  client.available();
+  SerialMon.print(F(", then connected "));
+  SerialMon.print(client.connected());
+  SerialMon.print(F(", write error "));
+  SerialMon.println(client.getWriteError());
+
+  // No acknowledgements at all: the write past the window gives up
+  connect();
+  fake.sendMode = FakeSim800::SEND_SILENT;
+  for (int i = 0; i < TINY_GSM_SEND_WINDOW; i++) {
+    client.write(block, sizeof(block));
+  }
+  uint32_t start = millis();
+  n = client.write(block, sizeof(block));
+  SerialMon.print(F("  silent: write "));
+  SerialMon.print(TINY_GSM_SEND_WINDOW + 1);
+  SerialMon.print(F(" took "));
+  SerialMon.print(n);
+  SerialMon.print(F(" after "));
+  SerialMon.print(millis() - start);
+  SerialMon.print(F(" ms, connected "));
+  SerialMon.print(client.connected());
+  SerialMon.print(F(", write error "));
+  SerialMon.println(client.getWriteError());
+
+  // The acknowledgements turn up on the next connection
+  connect();
+  fake.ackLate();
+  start = millis();
+  bool ok = true;
+  for (int i = 0; i < 2 * TINY_GSM_SEND_WINDOW; i++) {
+    ok &= client.write(block, sizeof(block)) == sizeof(block);
+  }
+  client.available();
+  SerialMon.print(F("  late acks: "));
+  SerialMon.print(2 * TINY_GSM_SEND_WINDOW);
+  SerialMon.print(F(" writes "));
+  SerialMon.print(ok ? F("all taken") : F("short"));
+  SerialMon.print(F(" in "));
+  SerialMon.print(millis() - start);
+  SerialMon.print(F(" ms, connected "));
+  SerialMon.print(client.connected());
+  SerialMon.print(F(", write error "));
+  SerialMon.println(client.getWriteError());
+  client.stop();
+}
+
+// Reads for 20 s while 100 bytes arrive silently every gap_ms (0: never)
+void pollCase(uint32_t gap_ms) {
+  client.init(&modem, 1);
+  connect();
+  modem.poll_stats.useful = modem.poll_stats.wasted = 0;
+  uint32_t start = millis();
+  uint32_t last = start;
+  size_t got = 0;
+  bool intact = true;
+  while (millis() - start < 20000) {
+    if (gap_ms && millis() - last >= gap_ms) {
+      last += gap_ms;
+      fake.arrive(100, false);
+    }
+    if (client.available()) {
+      uint8_t buf[64];
+      int n = client.read(buf, sizeof(buf));
+      for (int i = 0; i < n; i++, got++) {
+        intact &= buf[i] == (uint8_t)got;
+      }
+    }
+  }
+  if (gap_ms) {
+    SerialMon.print(F("  data every "));
+    SerialMon.print(gap_ms);
+    SerialMon.print(F(" ms: "));
+  } else {
+    SerialMon.print(F("  no data: "));
+  }
+  SerialMon.print(fake.polls);
+  SerialMon.print(F(" polls, useful "));
+  SerialMon.print(modem.poll_stats.useful);
+  SerialMon.print(F(", wasted "));
+  SerialMon.print(modem.poll_stats.wasted);
+  SerialMon.print(F(", read "));
+  SerialMon.print(got);
+  SerialMon.print(F(" of "));
+  SerialMon.print(fake.arrived);
+  SerialMon.println(intact ? F(" bytes, intact") : F(" bytes, not intact"));
+  client.stop();
+}
+
+void polling() {
+  SerialMon.println(F("polling"));
+  pollCase(0);
+  pollCase(5000);
+  pollCase(1000);
+}
+
+void urcDrain() {
+  SerialMon.println(F("URC drain"));
+  connect();
+
+  // Announced data: the URC is taken as soon as the UART is idle, and
+  // the next maintain() asks about that one socket
+  fake.arrive(100, true);
+  uint32_t start = micros();
+  modem.maintain();
+  uint32_t us = micros() - start;
+  SerialMon.print(F("  maintain() over a data URC: "));
+  SerialMon.print(us);
+  SerialMon.print(F(" us, the next one sent "));
+  modem.maintain();
+  SerialMon.print(fake.commands);
+  SerialMon.print(F(" command(s), "));
+  SerialMon.print(client.available());
+  SerialMon.println(F(" bytes available"));
+
+  // Only maintain() stops early, a plain wait keeps its timeout
+  fake.urc("\r\n+CIPRXGET: 1,1\r\n");
+  start = millis();
+  modem.waitResponse(200, NULL, NULL);
+  SerialMon.print(F("  waitResponse(200, NULL, NULL) over a URC: "));
+  SerialMon.print(millis() - start);
+  SerialMon.println(F(" ms"));
+
+  // Nothing flagged, nothing asked
+  while (client.available()) client.read();
+  modem.maintain();
+  fake.reset();
+  for (int i = 0; i < 100; i++) {
+    modem.maintain();
+  }
+  SerialMon.print(F("  100 idle maintain() calls sent "));
+  SerialMon.print(fake.commands);
+  SerialMon.println(F(" command(s)"));
+  client.stop();
+}
+
+void resumeCase(const char* state, int cipmux, bool attached) {
+  fake.reset();
+  fake.ipState = state;
+  fake.cipmux = cipmux;
+  fake.attached = attached;
+  uint32_t start = millis();
+  bool ok = modem.gprsResume("internet");
+  uint32_t ms = millis() - start;
+  SerialMon.print(F("  "));
+  SerialMon.print(state);
+  SerialMon.print(cipmux ? F(", multi-IP") : F(", single-IP"));
+  SerialMon.print(attached ? F(", attached: ") : F(", detached: "));
+  SerialMon.print(ok ? F("up") : F("failed"));
+  SerialMon.print(F(" after "));
+  SerialMon.print(fake.commands);
+  SerialMon.print(F(" commands, "));
+  SerialMon.print(ms);
+  SerialMon.print(F(" ms, "));
+  SerialMon.print(fake.available());
+  SerialMon.println(F(" bytes left over"));
+}
+
+void resume() {
+  SerialMon.println(F("resume"));
+  resumeCase("IP STATUS", 1, true);
+  resumeCase("IP PROCESSING", 1, true);
+  resumeCase("IP GPRSACT", 1, true);
+  resumeCase("IP START", 1, true);
+  resumeCase("IP INITIAL", 1, true);
+  resumeCase("IP INITIAL", 1, false);
+  resumeCase("IP STATUS", 0, true);
+  resumeCase("PDP DEACT", 1, true);
+}
+
+void setup() {
+  SerialMon.begin(115200);
+  delay(10);
+
+  client.setTimeout(1000);
+  txBuffer();
+  sendWindow();
+  polling();
+  urcDrain();
+  resume();
+}
+
+void loop() {
+}
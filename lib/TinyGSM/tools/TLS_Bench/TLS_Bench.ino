@@ -0,0 +1,147 @@
+/**************************************************************
+ *
+ * This script compares TLS done by the modem (AT+CIPSSL and
+ * the like) with TLS done by mbedTLS on the board through
+ * TinyGsmClientTls, both with a full handshake and with a
+ * resumed session.  It needs a core that ships mbedTLS, such
+ * as the ESP32.
+ *
+ * A local server that resumes sessions will do, e.g.
+ *   openssl req -x509 -newkey rsa:2048 -nodes -subj /CN=bench \
+ *     -keyout key.pem -out cert.pem
+ *   openssl s_server -accept 4433 -key key.pem -cert cert.pem -www
+ * made reachable from the modem's network.
+ *
+ * To time the library without a modem or a network, record a
+ * run with TinyGsmStreamRecorder and play it back with the
+ * AT_Replay tool.
+ *
+ * TinyGSM Getting Started guide:
+ *   https://tiny.cc/tinygsm-readme
+ *
+ **************************************************************/
+
+// Select your modem:
+#define TINY_GSM_MODEM_SIM800
+// #define TINY_GSM_MODEM_SIM7000
+// #define TINY_GSM_MODEM_SIM7600
+// #define TINY_GSM_MODEM_UBLOX
+// #define TINY_GSM_MODEM_BG96
+
+// Set serial for debug console (to the Serial Monitor, default speed 115200)
+#define SerialMon Serial
+
+// Set serial for AT commands (to the module)
+#define SerialAT Serial1
+
+#define TINY_GSM_RX_BUFFER 1024
+
+// Your GPRS credentials, if any
+const char apn[]  = "YourAPN";
+const char gprsUser[] = "";
+const char gprsPass[] = "";
+
+// Server to benchmark against
+const char server[] = "bench.example.com";
+const int  port     = 4433;
+
+// Handshakes per variant
+#define BENCH_ROUNDS 5
+
+#include <TinyGsmClient.h>
+#include <TinyGsmClientTls.h>
+
+TinyGsm modem(SerialAT);
+
+// The modem's own TLS: only the time can be measured, the handshake bytes
+// never cross the UART
+void benchModem() {
+  uint32_t total = 0;
+  int ok = 0;
+  for (int i = 0; i < BENCH_ROUNDS; i++) {
+    TinyGsmClientSecure client(modem);
+    uint32_t start = millis();
+    if (client.connect(server, port, 75)) {
+      total += millis() - start;
+      ok++;
+    }
+    client.stop();
+  }
+  SerialMon.print(F("modem TLS      "));
+  SerialMon.print(ok ? total / ok : 0);
+  SerialMon.print(F(" ms, "));
+  SerialMon.print(ok);
+  SerialMon.println(F(" connected"));
+}
+
+void benchBoard(bool resume) {
+  TinyGsmClient socket(modem);
+  TinyGsmClientTls tls(socket);
+  // The bench server's certificate is a throwaway one
+  tls.setInsecure();
+  uint32_t ms = 0, tx = 0, rx = 0;
+  int ok = 0, resumed = 0;
+  for (int i = 0; i < BENCH_ROUNDS + resume; i++) {
+    if (!resume) {
+      tls.clearSession();
+    }
+    if (!tls.connect(server, port)) {
+      SerialMon.print(F("handshake failed: -0x"));
+      SerialMon.println(-tls.lastError(), HEX);
+      continue;
+    }
+    tls.stop();
+    // The first round only gets a session to resume
+    if (resume && !i) {
+      continue;
+    }
+    ms += tls.handshakeMs();
+    tx += tls.handshakeBytesTx();
+    rx += tls.handshakeBytesRx();
+    resumed += tls.sessionResumed();
+    ok++;
+  }
+  if (!ok) {
+    return;
+  }
+  SerialMon.print(resume ? F("board resumed  ") : F("board full     "));
+  SerialMon.print(ms / ok);
+  SerialMon.print(F(" ms, "));
+  SerialMon.print(tx / ok);
+  SerialMon.print(F("/"));
+  SerialMon.print(rx / ok);
+  SerialMon.print(F(" bytes out/in, "));
+  SerialMon.print(resumed);
+  SerialMon.print(F("/"));
+  SerialMon.print(ok);
+  SerialMon.println(F(" resumed"));
+}
+
+void setup() {
+  SerialMon.begin(115200);
+  delay(10);
+
+  TinyGsmAutoBaud(SerialAT, 9600, 115200);
+  modem.init();
+
+  SerialMon.print(F("Waiting for network..."));
+  if (!modem.waitForNetwork(60000L)) {
+    SerialMon.println(F(" fail"));
+    return;
+  }
+  SerialMon.println(F(" OK"));
+
+  if (!modem.gprsConnect(apn, gprsUser, gprsPass)) {
+    SerialMon.println(F("GPRS failed"));
+    return;
+  }
+
+  benchModem();
+  benchBoard(false);
+  benchBoard(true);
+
+  modem.gprsDisconnect();
+}
+
+void loop() {
+}
@@ -1,18 +1,57 @@
 // Device not found, scanning again
 #include <Arduino.h>
 #include <Update.h>
+#include <Preferences.h>
 
 #define SerialMon Serial
 #define SerialAT Serial1
 
-#define DEBUG_PRINT(...) { SerialMon.print(millis()); SerialMon.print(" - "); SerialMon.println(__VA_ARGS__); }
-#define DEBUG_FATAL(...) { SerialMon.print(millis()); SerialMon.print(" - FATAL: "); SerialMon.println(__VA_ARGS__); delay(1000); ESP.restart(); }
+// Log lines are queued in RAM and printed by a background task, so that
+// a slow console never holds up the modem or the flash writes
+#define DEBUG_PRINT(...) DBG(__VA_ARGS__)
+#define DEBUG_FATAL(...) { DBG(F("FATAL:"), __VA_ARGS__); TinyGsmLogFlush(SerialMon); delay(1000); ESP.restart(); }
 
 #define TINY_GSM_MODEM_SIM800      // Modem is SIM800
 #define TINY_GSM_RX_BUFFER   1024  // Set RX buffer to 1Kb
+#define TINY_GSM_TX_BUFFER   256   // Combine small writes into one CIPSEND
+#define TINY_GSM_DEBUG SerialMon   // Library messages go to the same log
+#define TINY_GSM_DEBUG_LEVEL 1     // Leave out per-packet messages
+#define TINY_GSM_DEBUG_DEFERRED 4096 // Log ring size in bytes
 #include "TinyGsmClient.h"
+#include "TinyGsmClientTls.h"
+// The last socket is kept out of the pool for plain http
+#define TINY_GSM_POOL_SLOTS (TINY_GSM_MUX_COUNT - 1)
+#include "TinyGsmClientPool.h"
 TinyGsm modem(SerialAT);
 
+// OTA_TRANSPARENT fetches an http image in transparent mode, with no AT
+// framing per chunk.  The modem then sends as fast as the link brings data
+// in, so while flash is being written only RTS/CTS can hold it back: the
+// pins must be wired and given as MODEM_RTS_PIN and MODEM_CTS_PIN (the
+// modem's RTS and CTS lines).  An image that contains the modem's
+// "CLOSED" line ends the transfer early, as the two can't be told apart.
+#if defined(OTA_TRANSPARENT) && !(defined(MODEM_RTS_PIN) && defined(MODEM_CTS_PIN))
+  #error "OTA_TRANSPARENT needs RTS/CTS: define MODEM_RTS_PIN and MODEM_CTS_PIN"
+#endif
+// Room for what arrives before RTS takes effect
+#define MODEM_RX_BUFFER 4096
+
+// The update server is checked against the SHA-256 fingerprint of its
+// certificate (OTA_TLS_FINGERPRINT, hex) or a root CA (OTA_TLS_CA, PEM),
+// set in build_flags; OTA_TLS_INSECURE skips the check.  With none of
+// them, TLS is left to the modem as before.
+#if !defined(OTA_TLS_FINGERPRINT) && !defined(OTA_TLS_CA) && \
+    !defined(OTA_TLS_INSECURE) && !defined(MODEM_CIPSSL)
+  #define MODEM_CIPSSL
+#endif
+
+// Connections kept open between requests to the same server
+#ifdef MODEM_CIPSSL
+TinyGsmClientPool<TinyGsm, TinyGsmClientSecure> pool(modem);
+#else
+TinyGsmClientPool<TinyGsm> pool(modem);
+#endif
+
 void printDeviceInfo(){
   Serial.println();
   Serial.println("--------------------------");
@@ -24,41 +63,363 @@ void printDeviceInfo(){
   Serial.println("--------------------------");
 }
 
-bool atCheck(int timeout) {
-  SerialAT.println("AT");
-  SerialAT.setTimeout(timeout);
-  String respondSerialAT = SerialAT.readString();
-  Serial.println("respondSerialAT :\t" + respondSerialAT);
-  if (respondSerialAT.length() <= 0) {
-    return false;
+// Boot timeline: when each stage of bringing the modem up was reached, in
+// ms since reset.  Printed with the build stamp once the first byte of the
+// update arrives, so every build reports its own time to first byte.
+struct BootStage {
+  const char* name;
+  uint32_t    at;
+};
+BootStage bootStages[12];
+uint8_t   bootStageCount = 0;
+
+void bootMark(const char* name, uint32_t at = millis()) {
+  if (bootStageCount < sizeof(bootStages) / sizeof(bootStages[0])) {
+    bootStages[bootStageCount].name = name;
+    bootStages[bootStageCount].at = at;
+    bootStageCount++;
+  }
+  DEBUG_PRINT(F("[boot]"), name);
+}
+
+void bootReport() {
+  SerialMon.println(String("[boot] timeline, build ") + __DATE__ " " __TIME__);
+  uint32_t prev = 0;
+  for (uint8_t i = 0; i < bootStageCount; i++) {
+    SerialMon.println(String("[boot] ") + bootStages[i].at + " ms  +" +
+                      (bootStages[i].at - prev) + "  " + bootStages[i].name);
+    prev = bootStages[i].at;
+  }
+}
+
+// Power-on URCs, stamped by the matcher when they arrive
+GsmConstStr urcRdy = GF(GSM_NL "RDY");
+GsmConstStr urcCallReady = GF(GSM_NL "Call Ready");
+uint32_t modemRdyAt = 0;
+uint32_t modemCallReadyAt = 0;
+
+void onBootUrc(const char* args, void* ctx) {
+  *(uint32_t*)ctx = millis();
+}
+
+// Reads what the modem sends until the URC behind at has been seen
+bool waitBootUrc(uint32_t& at, uint32_t timeout_ms) {
+  for (uint32_t start = millis(); !at && millis() - start < timeout_ms; ) {
+    modem.maintain();
+    delay(1);
+  }
+  return at != 0;
+}
+
+#define OTA_HOST "mamunsyuhada.pogungengineering.ai"
+
+#define MODEM_RX_PIN  27
+#define MODEM_TX_PIN  26
+// Drives the modem's PWRKEY through a transistor: held high for a second,
+// it powers the modem on
+#define MODEM_PWRKEY  22
+#define MODEM_PWRKEY_MS 1100
+
+// Rate the modem answered at last time, kept across boots
+Preferences modemPrefs;
+
+uint32_t savedBaudRate() {
+  modemPrefs.begin("modem", true);
+  uint32_t saved = modemPrefs.getUInt("baud", 0);
+  modemPrefs.end();
+  return saved;
+}
+
+uint32_t countBoot() {
+  modemPrefs.begin("modem", false);
+  uint32_t count = modemPrefs.getUInt("boots", 0) + 1;
+  modemPrefs.putUInt("boots", count);
+  modemPrefs.end();
+  return count;
+}
+
+// Operator that registered last time, tried first on the next boot.  How
+// long attaching took is kept per attempt kind, in buckets of <1, <2, <4 ...
+// <64 and >=64 s, so the effect of the hint shows over many boots.
+struct AttachStats {
+  uint16_t hinted[8];
+  uint16_t unhinted[8];
+};
+
+void attachRecord(bool hinted, uint32_t ms) {
+  AttachStats stats;
+  modemPrefs.begin("modem", false);
+  if (modemPrefs.getBytes("attach", &stats, sizeof(stats)) != sizeof(stats)) {
+    memset(&stats, 0, sizeof(stats));
+  }
+  uint8_t b = 0;
+  for (uint32_t sec = ms / 1000; sec && b < 7; sec >>= 1) {
+    b++;
+  }
+  uint16_t* hist = hinted ? stats.hinted : stats.unhinted;
+  hist[b]++;
+  modemPrefs.putBytes("attach", &stats, sizeof(stats));
+  modemPrefs.end();
+
+  for (int k = 0; k < 2; k++) {
+    String line = k ? "[attach] hinted  " : "[attach] no hint ";
+    for (int i = 0; i < 8; i++) {
+      line += String(" ") + (k ? stats.hinted[i] : stats.unhinted[i]);
+    }
+    SerialMon.println(line);
+  }
+}
+
+// Address of the update server, kept across boots so a connection can be
+// opened by IP without a DNS round trip.  The modem's lookup gives no TTL,
+// so entries are trusted for DNS_TTL_S by the network clock.  Not every
+// network sends the time, so without it an entry is trusted for
+// DNS_TTL_BOOTS boots instead.
+#define DNS_TTL_S (24UL * 3600)
+#define DNS_TTL_BOOTS 8
+
+struct DnsEntry {
+  char     host[64];
+  uint32_t ip;
+  uint32_t expires;
+  uint32_t boot;
+};
+DnsEntry dnsEntry;
+uint32_t bootCount = 0;
+bool     dnsPending = false;
+bool     dnsAnswered = false;
+
+GsmConstStr urcDnsResult = GF(GSM_NL "+CDNSGIP:");
+
+// Seconds since 2000 by the modem's clock, or 0 if the network hasn't set it
+uint32_t modemClock() {
+  // "yy/MM/dd,hh:mm:ss+zz"
+  String t = modem.getGSMDateTime(DATE_FULL);
+  struct tm tm = {};
+  if (sscanf(t.c_str(), "%d/%d/%d,%d:%d:%d", &tm.tm_year, &tm.tm_mon,
+             &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6 ||
+      tm.tm_year < 20) {
+    return 0;
+  }
+  tm.tm_year += 100;
+  tm.tm_mon -= 1;
+  return mktime(&tm) - 946684800UL;
+}
+
+void dnsStore(IPAddress ip) {
+  uint32_t now = modemClock();
+  dnsEntry.ip = ip;
+  dnsEntry.expires = now ? now + DNS_TTL_S : 0;
+  dnsEntry.boot = bootCount;
+  modemPrefs.begin("modem", false);
+  modemPrefs.putBytes("dns", &dnsEntry, sizeof(dnsEntry));
+  modemPrefs.end();
+  DEBUG_PRINT(F("[dns]"), dnsEntry.host, F("="), ip);
+}
+
+void onDnsUrc(const char* args, void* ctx) {
+  IPAddress ip = TinyGsmParseDnsResult(args);
+  dnsPending = false;
+  if (ip != IPAddress(0, 0, 0, 0)) {
+    // Saved once the URC handler has returned
+    dnsEntry.ip = ip;
+    dnsAnswered = true;
+  }
+}
+
+// Starts looking host up unless the saved address is still fresh, so the
+// answer can arrive while other commands run
+void dnsPrefetch(const char* host) {
+  modemPrefs.begin("modem", true);
+  if (modemPrefs.getBytes("dns", &dnsEntry, sizeof(dnsEntry)) != sizeof(dnsEntry) ||
+      strncmp(dnsEntry.host, host, sizeof(dnsEntry.host))) {
+    memset(&dnsEntry, 0, sizeof(dnsEntry));
+    strncpy(dnsEntry.host, host, sizeof(dnsEntry.host) - 1);
+  }
+  modemPrefs.end();
+
+  uint32_t now = dnsEntry.ip ? modemClock() : 0;
+  if (dnsEntry.ip && (now ? now < dnsEntry.expires
+                          : bootCount - dnsEntry.boot < DNS_TTL_BOOTS)) {
+    DEBUG_PRINT(F("[dns] cached"), host);
+    return;
+  }
+  // Without room for the handler the modem looks the name up itself
+  dnsPending = modem.addUrcHandler(urcDnsResult, onDnsUrc) &&
+               modem.dnsRequest(host);
+  if (!dnsPending) {
+    modem.removeUrcHandler(urcDnsResult);
+  }
+}
+
+// Address to connect to for host: the saved one if fresh, else the
+// prefetched answer; 0.0.0.0 leaves the lookup to the modem
+IPAddress dnsAddress(const char* host) {
+  if (strncmp(dnsEntry.host, host, sizeof(dnsEntry.host))) {
+    return IPAddress(0, 0, 0, 0);
+  }
+  for (uint32_t start = millis(); dnsPending && millis() - start < 10000L; ) {
+    modem.maintain();
+    delay(1);
+  }
+  modem.removeUrcHandler(urcDnsResult);
+  dnsPending = false;
+  if (dnsAnswered) {
+    dnsAnswered = false;
+    dnsStore(dnsEntry.ip);
+  }
+  return IPAddress(dnsEntry.ip);
+}
+
+void dnsForget() {
+  dnsEntry.ip = 0;
+  modemPrefs.begin("modem", false);
+  modemPrefs.remove("dns");
+  modemPrefs.end();
+}
+
+// TLS session of the last full handshake with the update server, so the
+// next boot gets away with an abbreviated one.  Sized as it comes: with a
+// ticket it runs to a few hundred bytes.
+void tlsSessionLoad(TinyGsmClientTls& tls) {
+  modemPrefs.begin("modem", true);
+  size_t size = modemPrefs.getBytesLength("tls");
+  uint8_t* buf = size ? (uint8_t*)malloc(size) : NULL;
+  size_t len = buf ? modemPrefs.getBytes("tls", buf, size) : 0;
+  modemPrefs.end();
+  if (len && !tls.setSession(buf, len)) {
+    DEBUG_PRINT(F("[tls] saved session unusable"));
+  }
+  free(buf);
+}
+
+void tlsSessionSave(TinyGsmClientTls& tls) {
+  size_t needed = 0;
+  tls.getSession(NULL, 0, &needed);
+  uint8_t* buf = needed ? (uint8_t*)malloc(needed) : NULL;
+  size_t len = buf ? tls.getSession(buf, needed) : 0;
+  modemPrefs.begin("modem", false);
+  if (len) {
+    modemPrefs.putBytes("tls", buf, len);
+  } else {
+    modemPrefs.remove("tls");
+    DEBUG_PRINT(F("[tls] session not saved, needs"), needed, F("bytes"));
+  }
+  modemPrefs.end();
+  free(buf);
+}
+
+// One TLS client per pool slot, made on first use; the one that has just
+// done a handshake is left in tlsOpened
+TinyGsmClientTls* tlsSlots[TINY_GSM_POOL_SLOTS];
+TinyGsmClientTls* tlsOpened = NULL;
+
+Client* makeTls(uint8_t slot, Client& socket, const char* host, void* ctx) {
+  if (!tlsSlots[slot]) {
+    tlsSlots[slot] = new TinyGsmClientTls(socket);
+#if defined(OTA_TLS_FINGERPRINT)
+    tlsSlots[slot]->setFingerprint(OTA_TLS_FINGERPRINT);
+#endif
+#if defined(OTA_TLS_CA)
+    tlsSlots[slot]->setCACert(OTA_TLS_CA);
+#endif
+#if defined(OTA_TLS_INSECURE)
+    tlsSlots[slot]->setInsecure();
+#endif
+    tlsSessionLoad(*tlsSlots[slot]);
+  }
+  tlsSlots[slot]->setHostname(host);
+  tlsOpened = tlsSlots[slot];
+  return tlsSlots[slot];
+}
+
+bool modemAnswersAt(uint32_t rate) {
+  SerialAT.begin(rate, SERIAL_8N1, MODEM_TX_PIN, MODEM_RX_PIN);
+  // An auto-bauding modem needs a few probes to lock on
+  for (unsigned int i = 0; i < 10; i++) {
+    if (TinyGsmProbeAT(SerialAT, 50)) {
+      return true;
+    }
   }
-  return respondSerialAT.indexOf("OK") >= 0;
+  return false;
 }
 
+// Tries the last good rate first, then (with MODEM_BAUD_DETECT) lets the
+// UART measure the modem's power-on "RDY", then scans.  Once found, the rate
+// is pinned in the modem and saved, so the next boot answers on the first
+// probe.  Returns 0 if the modem didn't answer at all.
 uint32_t scanBaudRate() {
   static uint32_t rates[] = {115200, 9600, 4800, 57600};
 
-  for (unsigned i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
-    delay(500);
+  modemPrefs.begin("modem", false);
+  uint32_t saved = modemPrefs.getUInt("baud", 0);
+  uint32_t found = 0;
+
+  if (saved && modemAnswersAt(saved)) {
+    Serial.println("[scanBaudRate] saved rate " + String(saved));
+    found = saved;
+  }
+
+#ifdef MODEM_BAUD_DETECT
+  if (!found) {
+    SerialAT.begin(0, SERIAL_8N1, MODEM_TX_PIN, MODEM_RX_PIN, false, 1000);
+    uint32_t measured = SerialAT.baudRate();
+    for (unsigned i = 0; measured && i < sizeof(rates) / sizeof(rates[0]); i++) {
+      // The measurement is only approximate
+      if (measured > rates[i] * 95 / 100 && measured < rates[i] * 105 / 100 &&
+          modemAnswersAt(rates[i])) {
+        Serial.println("[scanBaudRate] detected " + String(rates[i]));
+        found = rates[i];
+      }
+    }
+  }
+#endif
+
+  for (unsigned i = 0; !found && i < sizeof(rates) / sizeof(rates[0]); i++) {
     uint32_t rate = rates[i];
+    if (rate == saved) {
+      continue;
+    }
     Serial.print(String("\r "));
     Serial.println("[scanBaudRate] make sure in " + String(rate));
+    if (modemAnswersAt(rate)) {
+      found = rate;
+    }
+  }
 
-    static const int RXPin = 27, TXPin = 26;
-    SerialAT.begin(rate, SERIAL_8N1, TXPin, RXPin);
-
-    unsigned int counterAT = 0;
-    for (unsigned int i = 0; i < 15; i++) {
-      if (atCheck(500)) {
-        Serial.println("[scanBaudRate] >> counterAT " + String(counterAT));
-        counterAT++;
-      }
+  if (found && found != saved) {
+    if (modem.pinBaud(found)) {
+      modemPrefs.putUInt("baud", found);
+    } else {
+      Serial.println("[scanBaudRate] could not pin " + String(found));
     }
+  }
+  modemPrefs.end();
+  return found;
+}
 
-    if (counterAT > 5) {
-      return rate;
+// Reads one response header line into buf, trimmed; false at the blank
+// line that ends the headers.  A modem socket finds the line break in its
+// FIFO with readUntil(); TLS on the ESP and the transparent link keep no
+// FIFO to scan, so they go through Stream.  The rest of a line too long
+// for buf is dropped.
+bool headerLine(Client* client, TinyGsmClient* socket, char* buf, size_t max) {
+  size_t len = socket ? socket->readUntil('\n', buf, max - 1)
+                      : client->readBytesUntil('\n', buf, max - 1);
+  if (len == max - 1) {
+    // Full, so the line break hasn't been read
+    if (socket) {
+      socket->find("\n");
+    } else {
+      client->find((char*)"\n");
     }
   }
+  bool blank = len == 0 || (len == 1 && buf[0] == '\r');
+  while (len && isspace((uint8_t)buf[len - 1])) {
+    len--;
+  }
+  buf[len] = '\0';
+  return !blank;
 }
 
 void startOtaUpdate(
@@ -78,91 +439,139 @@ void startOtaUpdate(
   Serial.println("url : " + url);
   Serial.println("port : " + String(port));
 
-  DEBUG_PRINT(String("Connecting to ") + host + ":" + port);
+  DEBUG_PRINT(F("Connecting to"), host, F("port"), port);
+
+  // By address if one is known, so the modem skips its own lookup
+  IPAddress ip = dnsAddress(host.c_str());
 
   Client* client = NULL;
+  TinyGsmClient* socket = NULL;   // client, if it is a plain modem socket
+  bool pooled = protocol == "https";
   if (protocol == "http") {
-    client = new TinyGsmClient(modem);
-    if (!client->connect(host.c_str(), port)) {
+#ifdef OTA_TRANSPARENT
+    // Shuts the modem's IP stack down, taking pooled connections with it
+    static TinyGsmClientTransparent transparent(modem);
+    pool.closeAll();
+    client = &transparent;
+#else
+    // The modem holds the data until it is asked for it
+    static TinyGsmClient plain(modem, TINY_GSM_POOL_SLOTS);
+    client = socket = &plain;
+#endif
+    if (!(ip != IPAddress(0, 0, 0, 0) && client->connect(ip, port)) &&
+        !client->connect(host.c_str(), port)) {
       DEBUG_FATAL(F("Client not connected"));
     }
   }
-  else if (protocol == "https") {
-    client = new TinyGsmClientSecure(modem);
-    if (!client->connect(host.c_str(), port)) {
+  else if (pooled) {
+    // With TLS on the ESP unless the modem is asked to do it
+#ifdef MODEM_CIPSSL
+    bool secure = false;
+#else
+    bool secure = true;
+#endif
+    tlsOpened = NULL;
+    client = pool.acquire(host.c_str(), port, secure, ip);
+    if (!client && ip != IPAddress(0, 0, 0, 0)) {
+      // The server may have moved
+      dnsForget();
+      client = pool.acquire(host.c_str(), port, secure);
+    }
+    if (!client) {
       DEBUG_FATAL(F("Client not connected"));
     }
+#ifdef MODEM_CIPSSL
+    socket = static_cast<TinyGsmClientSecure*>(client);
+#endif
+    DEBUG_PRINT(F("[pool]"), pool.hits(), F("reused,"), pool.misses(), F("opened"));
   }
   else {
-    DEBUG_FATAL(String("Unsupported protocol: ") + protocol);
+    DEBUG_FATAL(F("Unsupported protocol:"), protocol);
   }
 
-  DEBUG_PRINT(String("Requesting ") + url);
+  if (tlsOpened) {
+    DEBUG_PRINT(F("[tls] handshake"), tlsOpened->handshakeMs(), F("ms,"),
+                tlsOpened->handshakeBytesTx(), F("bytes out,"),
+                tlsOpened->handshakeBytesRx(), F("in"),
+                tlsOpened->sessionResumed() ? F("(resumed)") : F(""));
+    if (!tlsOpened->sessionResumed()) {
+      tlsSessionSave(*tlsOpened);
+    }
+  }
+
+  bootMark("connected");
+  DEBUG_PRINT(F("Requesting"), url);
 
   client->print(String("GET ") + url + " HTTP/1.0\r\n"
                + "Host: " + host + "\r\n"
                + "Connection: keep-alive\r\n"
                + "\r\n");
 
+  bootMark("request sent");
+
   long timeout = millis();
   while (client->connected() && !client->available()) {
     if (millis() - timeout > 10000L) {
-      DEBUG_FATAL("Response timeout");
+      DEBUG_FATAL(F("Response timeout"));
     }
   }
+  bootMark("first byte");
+  bootReport();
 
   // Collect headers
   String md5;
   int contentLength = 0;
 
+  char line[128];
   while (client->available()) {
-    String line = client->readStringUntil('\n');
-    line.trim();
+    bool more = headerLine(client, socket, line, sizeof(line));
     //SerialMon.println(line);    // Uncomment this to show response headers
-    line.toLowerCase();
-    if (line.startsWith("content-length:")) {
-      contentLength = line.substring(line.lastIndexOf(':') + 1).toInt();
-    } else if (line.startsWith("x-md5:")) {
-      md5 = line.substring(line.lastIndexOf(':') + 1);
-    } else if (line.length() == 0) {
+    if (!more) {
       break;
+    } else if (!strncasecmp(line, "content-length:", 15)) {
+      contentLength = atoi(line + 15);
+    } else if (!strncasecmp(line, "x-md5:", 6)) {
+      md5 = line + 6;
+      md5.trim();
+      md5.toLowerCase();
     }
   }
   Serial.println("contentLength : " + String(contentLength));
 
   if (contentLength <= 0) {
-    DEBUG_FATAL("Content-Length not defined");
+    DEBUG_FATAL(F("Content-Length not defined"));
   }
 
   bool canBegin = Update.begin(contentLength);
   if (!canBegin) {
     Update.printError(SerialMon);
-    DEBUG_FATAL("OTA begin failed");
+    DEBUG_FATAL(F("OTA begin failed"));
   }
 
   Serial.println("md5:" + md5);
 
   if (md5.length()) {
-    DEBUG_PRINT(String("Expected MD5: ") + md5);
+    DEBUG_PRINT(F("Expected MD5:"), md5);
     if(!Update.setMD5(md5.c_str())) {
-      DEBUG_FATAL("Cannot set MD5");
+      DEBUG_FATAL(F("Cannot set MD5"));
     }
   }
 
-  DEBUG_PRINT("Flashing...");
+  DEBUG_PRINT(F("Flashing..."));
 
   // The next loop does approx. the same thing as Update.writeStream(http) or Update.write(http)
 
   int written = 0;
   int progress = 0;
   uint8_t buff[256];
+  uint32_t flashStart = millis();
 
   while (client->connected() && written < contentLength) {
     timeout = millis();
     while (client->connected() && !client->available()) {
       delay(1);
       if (millis() - timeout > 100000L) {
-        DEBUG_FATAL("Timeout");
+        DEBUG_FATAL(F("Timeout"));
       }
     }
 
@@ -180,9 +589,17 @@ void startOtaUpdate(
   }
   SerialMon.println();
 
+  // For comparing builds, e.g. with and without deferred logging
+  uint32_t flashMs = millis() - flashStart;
+  DEBUG_PRINT(F("Flashed"), written, F("bytes in"), flashMs, F("ms,"),
+              flashMs ? written / flashMs : 0, F("kB/s"));
+  // Data the modem didn't announce shows up as useful polls
+  DEBUG_PRINT(F("Fallback polls:"), modem.poll_stats.useful, F("useful,"),
+              modem.poll_stats.wasted, F("wasted"));
+
   if (written != contentLength) {
     Update.printError(SerialMon);
-    DEBUG_FATAL(String("Write failed. Written ") + written + " / " + contentLength + " bytes");
+    DEBUG_FATAL(F("Write failed. Written"), written, F("/"), contentLength, F("bytes"));
   }
 
   if (!Update.end()) {
@@ -194,7 +611,14 @@ void startOtaUpdate(
     DEBUG_FATAL(F("Update not finished"));
   }
 
-  DEBUG_PRINT("========= Update successfully completed. Rebooting. =========");
+  // The image was read to its end, so the connection can serve the next request
+  if (pooled) {
+    pool.release(client);
+  } else {
+    client->stop();
+  }
+
+  DEBUG_PRINT(F("========= Update successfully completed. Rebooting. ========="));
   delay(5000);
   ESP.restart();
 }
@@ -227,65 +651,149 @@ String getccid(){
   return "";
 }
 
-void trigger_sim(){
-  Serial.println("trigger_sim");
-  pinMode(22, OUTPUT);
+void setup() {
+  // After an ESP-only restart the modem is still up at its pinned rate,
+  // and pressing the power key would switch it off
+  bootCount = countBoot();
+#ifdef OTA_TRANSPARENT
+  SerialAT.setRxBufferSize(MODEM_RX_BUFFER);
+#endif
+  uint32_t saved = savedBaudRate();
+  if (saved) {
+    SerialAT.begin(saved, SERIAL_8N1, MODEM_TX_PIN, MODEM_RX_PIN);
+  }
+  // A second probe, since a modem busy with a URC can miss the first.  A
+  // restart in the middle of a transparent download leaves the modem in
+  // data mode, where it answers nothing until it is escaped.
+  bool warm = saved && (TinyGsmProbeAT(SerialAT, 50) || TinyGsmProbeAT(SerialAT, 100));
+#ifdef OTA_TRANSPARENT
+  if (saved && !warm) {
+    TinyGsmEscapeData(SerialAT);
+    warm = TinyGsmProbeAT(SerialAT, 100);
+  }
+#endif
 
-  digitalWrite(22, LOW);
-  delay(1000);
-  digitalWrite(22, HIGH);
-  delay(1000);
-  digitalWrite(22, LOW);
-}
+  // Otherwise press the power key first and do the ESP side while it is held
+  uint32_t keyAt = millis();
+  if (!warm) {
+    pinMode(MODEM_PWRKEY, OUTPUT);
+    digitalWrite(MODEM_PWRKEY, HIGH);
+  }
 
-void setup() {
-  delay(2000);
+  pool.setSecureFactory(makeTls);
 
   SerialMon.begin(115200);
-  delay(10);
+  TinyGsmLogStartTask(SerialMon);
+  bootMark(warm ? "modem already on" : "pwrkey down", keyAt);
   printDeviceInfo();
 
-  trigger_sim();
-
   SerialMon.println("  Firmware A is running--Firmware 1");
   SerialMon.println("--------------------------");
 
-  SerialMon.println("  Scan Baud Rate  ");
-  SerialMon.println("----" + String(scanBaudRate()) + "----");
+  if (!warm) {
+    modem.addUrcHandler(urcRdy, onBootUrc, &modemRdyAt);
+    modem.addUrcHandler(urcCallReady, onBootUrc, &modemCallReadyAt);
 
-  DEBUG_PRINT(F("Starting OTA update in 5 seconds..."));
-  delay(5000);
+    while (millis() - keyAt < MODEM_PWRKEY_MS) {
+      delay(1);
+    }
+    digitalWrite(MODEM_PWRKEY, LOW);
+    bootMark("pwrkey up");
+
+    // A modem pinned to a rate says RDY on it as soon as it is up
+    if (saved && waitBootUrc(modemRdyAt, 5000)) {
+      bootMark("RDY", modemRdyAt);
+    } else {
+      SerialMon.println("  Scan Baud Rate  ");
+      SerialMon.println("----" + String(scanBaudRate()) + "----");
+      bootMark("baud found");
+    }
 
+    // Call Ready means the SIM has been read; an auto-bauding modem that
+    // hasn't been pinned yet stays quiet, so this only waits if RDY came
+    if (modemRdyAt && waitBootUrc(modemCallReadyAt, 10000)) {
+      bootMark("Call Ready", modemCallReadyAt);
+    }
+    modem.removeUrcHandler(urcRdy);
+    modem.removeUrcHandler(urcCallReady);
+  }
 
-  DEBUG_PRINT(F("Checking Network..."));
-  while (true){
-    if(modem.isNetworkConnected()){
-      break;
+
+#ifdef OTA_TRANSPARENT
+  // The modem's side first, so neither end waits on a line the other ignores
+  if (modem.setFlowControl(true)) {
+    SerialAT.setPins(MODEM_TX_PIN, MODEM_RX_PIN, MODEM_RTS_PIN, MODEM_CTS_PIN);
+    SerialAT.setHwFlowCtrlMode(HW_FLOWCTRL_CTS_RTS);
+  } else {
+    DEBUG_FATAL(F("Could not enable flow control"));
+  }
+#endif
+
+  // CCLK keeps its power-on default unless the network may set it at
+  // registration, and the DNS cache's expiry goes by it
+  if (!modem.enableNetworkTime()) {
+    DEBUG_PRINT(F("Could not enable network time"));
+  }
+
+  DEBUG_PRINT(F("Waiting for network..."));
+  uint32_t attachStart = millis();
+  bool registered = modem.isNetworkConnected();
+  modemPrefs.begin("modem", true);
+  String hint = modemPrefs.getString("oper", "");
+  String band = modemPrefs.getString("band", "");
+  modemPrefs.end();
+  bool hinted = !registered && hint.length();
+  bool manual = false;
+  if (!registered && band.length() && band != modem.getBand()) {
+    // Searches the bands the operator was found on last time
+    DEBUG_PRINT(F("Restoring band"), band);
+    modem.setBand(band.c_str());
+  }
+  if (hinted) {
+    // Skips the scan if last time's operator is still there, otherwise
+    // the modem falls back to automatic selection
+    DEBUG_PRINT(F("Trying operator"), hint);
+    manual = modem.selectOperator(hint.c_str(), 20000L);
+  }
+  // Sleeps on the modem's +CREG reports instead of polling it
+  while (!registered && !modem.waitForRegistration(30000L)) {
+    DEBUG_PRINT(F("Network failed to connect, status"),
+                modem.lastRegistrationStatus());
+  }
+  if (!registered) {
+    uint32_t attachMs = millis() - attachStart;
+    DEBUG_PRINT(F("Attached in"), attachMs, F("ms"), hinted ? F("with hint") : F(""));
+    attachRecord(hinted, attachMs);
+    if (manual) {
+      // Else a lost operator would never be replaced by another
+      modem.selectOperatorAuto();
     }
-    else{
-      DEBUG_PRINT(F("Waiting for network..."));
-      bool network = modem.waitForNetwork(5000L);
-      Serial.println("Network : " + String(network));
-      Serial.println("getccid : " + getccid());
-      if (network == true) {
-        break;
-      }
-      DEBUG_PRINT(F("Network failed to connect"));
+    String oper = modem.getOperatorNumeric();
+    String operBand = modem.getBand();
+    modemPrefs.begin("modem", false);
+    if (oper.length() && oper != hint) {
+      modemPrefs.putString("oper", oper);
+    }
+    if (operBand.length() && operBand != band) {
+      modemPrefs.putString("band", operBand);
     }
+    modemPrefs.end();
   }
+  bootMark("registered");
   
 
   DEBUG_PRINT(F("Get CCID..."));
   Serial.println(getccid());
 
-  DEBUG_PRINT(F("Get Operator..."));
-  Serial.println(modem.getOperator());
-
   DEBUG_PRINT(F("Connecting to GPRS"));
   unsigned int i = 0;
+  uint32_t gprsStart = millis();
   while(true){
-    if (modem.gprsConnect("internet", "", "")==true) {
-      DEBUG_PRINT(F("Connected to GPRS"));  
+    // Picks up whatever part of the connection survived the restart
+    if (modem.gprsResume("internet", "", "")==true) {
+      DEBUG_PRINT(F("Connected to GPRS in"), millis() - gprsStart, F("ms"),
+                  warm ? F("(warm)") : F("(cold)"));
+      bootMark(warm ? "gprs (warm)" : "gprs (cold)");
       // delay(1000);
       break;
     }
@@ -300,6 +808,12 @@ void setup() {
   }
   i = 0;
 
+  // The lookup runs while the operator is read
+  dnsPrefetch(OTA_HOST);
+
+  DEBUG_PRINT(F("Get Operator..."));
+  Serial.println(modem.getOperator());
+
   /*
   host : mamunsyuhada.pogungengineering.ai
   url : /file/firmware/2020-08-25_10I27I28.bin
@@ -307,7 +821,7 @@ void setup() {
   */
   startOtaUpdate(
     "http",
-    "mamunsyuhada.pogungengineering.ai",
+    OTA_HOST,
     "/file/firmware/2020-08-25_10I27I28.bin",
     5443
   );
@@ -315,5 +829,5 @@ void setup() {
 
 void loop() {
   delay(1000);
-  DEBUG_PRINT("---Loop---");
+  DEBUG_PRINT(F("---Loop---"));
 }
\ No newline at end of file